@@ -0,0 +1,135 @@
+// Times parse_config() on generated 100k-line config files.
+// Built and run by `make bench`; it compiles macD.c in directly so the parser is timed without launching anything.
+#define main macd_main
+#include "../src/macD.c"
+#undef main
+
+/// Lines in each generated config file (excluding the timelimit line)
+#define BENCH_LINES 100000
+
+/// How many times each config file is parsed; the best and median runs are reported
+#define BENCH_RUNS 5
+
+/// @brief The kinds of config file the benchmark generates.
+typedef enum
+{
+    BENCH_PLAIN,   // `/bin/sleep 100` on every line
+    BENCH_QUOTA,   // `cpuquota=50` on every line
+    BENCH_MIXED    // Quotes, escapes, `$VAR`s, and `id=`/`after=` chains
+} BenchKind;
+
+/// @brief Writes a config file with `BENCH_LINES` process lines of the given kind.
+/// @param path The path of the file to write.
+/// @param kind The kind of lines to write.
+void generate_config(const char *path, BenchKind kind)
+{
+    FILE *config_file = fopen(path, "w");
+    if (!config_file)
+    {
+        perror("Failed to create benchmark config file");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(config_file, "timelimit 20\n");
+
+    for (int i = 0; i < BENCH_LINES; i++)
+    {
+        switch (kind)
+        {
+        case BENCH_PLAIN:
+            fprintf(config_file, "/bin/sleep 100\n");
+            break;
+        case BENCH_QUOTA:
+            fprintf(config_file, "cpuquota=50 /bin/sleep 100\n");
+            break;
+        default:
+            if (i % 4 == 0)
+            {
+                fprintf(config_file, "id=job%d /bin/echo \"hello world\" 'single quoted' $BENCH_DIR\n", i);
+            }
+            else if (i % 4 == 1)
+            {
+                fprintf(config_file, "after=job%d /bin/sh -c \"echo \\\"nested\\\" ${BENCH_USER}\"\r\n", i - 1);
+            }
+            else
+            {
+                fprintf(config_file, "  cpuquota=25\t/bin/sleep   100  \n");
+            }
+            break;
+        }
+    }
+
+    fclose(config_file);
+}
+
+/// @brief Compares two run times, for `qsort`.
+int compare_run_times(const void *a, const void *b)
+{
+    double difference = *(const double *)a - *(const double *)b;
+    return (difference > 0) - (difference < 0);
+}
+
+/// @brief Parses a config file `BENCH_RUNS` times and prints the best and median parse times.
+/// @param path The path of the config file.
+/// @param description What the config file contains, for the report.
+void time_parse_config(const char *path, const char *description)
+{
+    double run_times[BENCH_RUNS];
+
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        int timelimit;
+        int program_count = 0;
+        int capacity = ARG_MAX;
+
+        ProcessInfo *processes = calloc(capacity, sizeof(ProcessInfo));
+        if (!processes)
+        {
+            perror("Failed to allocate memory for processes array");
+            exit(EXIT_FAILURE);
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        parse_config(path, &timelimit, &processes, &program_count, &capacity);
+        run_times[run] = elapsed_usec_since(&start) / 1000.0;
+
+        if (program_count != BENCH_LINES)
+        {
+            fprintf(stderr, "Error: Parsed %d programs, expected %d.\n", program_count, BENCH_LINES);
+            exit(EXIT_FAILURE);
+        }
+
+        cleanup_processes(processes, &program_count);
+    }
+
+    qsort(run_times, BENCH_RUNS, sizeof(double), compare_run_times);
+    fprintf(stdout, "%d lines, %-28s best %6.1f ms, median %6.1f ms\n", BENCH_LINES, description, run_times[0], run_times[BENCH_RUNS / 2]);
+}
+
+int main()
+{
+    char path[] = "/tmp/macD-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+    {
+        perror("Failed to create benchmark config file");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    // The mixed config expands these, and they can't be relied on to be set already
+    setenv("BENCH_DIR", "/srv/jobs", 1);
+    setenv("BENCH_USER", "bench", 1);
+
+    const char *descriptions[] = {"no options:", "cpuquota= on each:", "quotes, $VARs, id=/after=:"};
+
+    for (BenchKind kind = BENCH_PLAIN; kind <= BENCH_MIXED; kind++)
+    {
+        generate_config(path, kind);
+        time_parse_config(path, descriptions[kind]);
+    }
+
+    unlink(path);
+    return 0;
+}
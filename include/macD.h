@@ -13,7 +13,44 @@
 #include <sys/stat.h>
 #include <linux/limits.h>
 #include <bits/getopt_core.h>
+#include <getopt.h>
+#include <sys/mman.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+
+/// The maximum number of programs a config file may list
+#define MAX_PROCESSES 262144
+
+/// Initial size of the args[] scratch array used while parsing a line (grows by doubling)
+#define INITIAL_ARGS_CAPACITY 8
+
+/// Size of each block the config arena allocates
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+
+/// Monitor loop granularity (the loop wakes this many times per second)
+#define MONITOR_TICKS_PER_SECOND 10
+#define MONITOR_TICK_USEC (1000000 / MONITOR_TICKS_PER_SECOND)
+
+/// `cpu.max` period used for cgroup-enforced CPU quotas (in microseconds)
+#define CPU_QUOTA_PERIOD_USEC 100000
+
+/// How often the process groups of quota-limited processes without a cgroup are re-discovered from `/proc`
+#define CPU_GROUP_SCAN_USEC 1000000
+
+/// How long a signal-driven shutdown waits for killed processes to be reaped
+#define TEARDOWN_TIMEOUT_USEC 2000000
+#define TEARDOWN_POLL_USEC 10000
+
+/// How many times (and how often) removing a still-populated cgroup is retried when macD exits
+#define CGROUP_REMOVE_ATTEMPTS 10
+#define CGROUP_REMOVE_RETRY_USEC 10000
+
+/// How long a shard may go without a heartbeat before the coordinator considers it stalled
+#define SHARD_STALL_SECONDS 3
 
 /// @brief A struct representing information about a process.
 typedef struct
@@ -23,8 +60,117 @@ typedef struct
     int running;
     int was_terminated;
     char **args;
+    int cpu_quota;                 // Percent of one core the process may use (0 = unlimited)
+    int kill_requested;            // Whether SIGKILL has already been sent to the process group
+    char *cgroup_path;             // The process' own cgroup, or NULL if cgroups are unavailable
+    int cgroup_quota;              // Whether `cpu_quota` is enforced by the cgroup's `cpu.max`
+    int cgroup_removal_pending;    // Whether the cgroup still has to be removed after the process was reaped
+    char *id;                      // Name other processes can depend on (`id=`), or NULL
+    char *after;                   // Comma-separated ids this process waits for (`after=`), or NULL
+    int *dependents;               // Indices of the processes waiting on this one
+    int dependent_count;
+    int dependent_capacity;
+    int waiting_on;                // Dependencies that haven't exited successfully yet
+    int started;                   // Whether launching the process has been attempted
+    int failed;                    // Whether the process failed to start, exited non-zero, or was killed
+    int skipped;                   // Whether the process will never run because a dependency failed
+    int shard;                     // The shard worker that owns the process (in `--shards` mode)
+    int config_line;               // The line of the config file the process was read from
+    int throttled;                 // Whether the process is currently stopped by the duty-cycle scheduler
+    long cpu_budget_usec;          // Remaining CPU time the process may use before being stopped
+    unsigned long long cpu_usec;   // CPU time (usec) used by the process and everything it spawned, as last sampled
+    pid_t *group_pids;             // Members of the process group, as of the last pass over `/proc` (without a cgroup)
+    int group_pid_count;
+    int group_pid_capacity;
+    unsigned long long tick_cpu_usec;    // `cpu_usec` at the previous monitor tick
+    unsigned long long report_cpu_usec;  // `cpu_usec` at the previous status report
+    struct timespec report_time;   // When `report_cpu_usec` was sampled
+    int cpu_percent;               // CPU usage since the previous status report
 } ProcessInfo;
 
+/// @brief A block of memory handed out by an `Arena`.
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+/// @brief A bump allocator whose allocations are all freed together.
+typedef struct
+{
+    ArenaBlock *head;
+} Arena;
+
+/// @brief The state of the single-pass config tokenizer over a config file in memory.
+typedef struct
+{
+    const char *cursor;       // The next byte to read
+    const char *end;          // One past the last byte of the file
+    const char *line_start;   // The first byte of the current line, for column numbers
+    const char *token_start;  // Where the last token started, before quotes and variables were decoded
+    int line;
+    char *token;              // The last token, decoded and null-terminated
+    size_t token_length;
+    size_t token_capacity;
+    char **args;              // Scratch space for the args of the line being parsed
+    size_t arg_count;
+    size_t args_capacity;
+} ConfigParser;
+
+/// @brief An open-addressing hash table from pid to process, for reaping without scanning every process.
+typedef struct
+{
+    int *slots;    // Process index + 1 for each occupied slot, `0` for empty ones
+    int capacity;  // Always a power of two
+} PidTable;
+
+/// @brief The state of a process, as shown in status reports.
+typedef enum
+{
+    PROCESS_WAITING,
+    PROCESS_RUNNING,
+    PROCESS_EXITED,
+    PROCESS_TERMINATED,
+    PROCESS_SKIPPED
+} ProcessState;
+
+/// @brief A snapshot of a process' state and resource usage.
+typedef struct
+{
+    pid_t pid;
+    ProcessState state;
+    int cpu_usage;
+    double memory_usage;
+} ProcessStatus;
+
+/// @brief The liveness of a shard worker, as seen by the coordinator.
+typedef struct
+{
+    pid_t pid;
+    volatile int heartbeat;  // Incremented by the worker on every monitor tick and every launch
+    int process_count;       // The number of processes the shard owns
+    int exited;              // Whether the coordinator has reaped the worker
+    int last_heartbeat;      // The heartbeat the coordinator saw on its previous check
+    int stalled_seconds;     // How long the heartbeat hasn't moved for
+} ShardInfo;
+
+/// @brief The table shard workers publish their state to, backed by shared memory.
+typedef struct
+{
+    int shard_count;
+    ShardInfo *shards;
+    ProcessStatus *processes;  // One row per process in the config, written only by its owning shard
+} ShardTable;
+
+/// @brief An `id=` paired with the index of its process, used to resolve `after=` lists.
+typedef struct
+{
+    const char *id;
+    int index;
+} ProcessId;
+
 /// Globals for signal handling
 extern volatile sig_atomic_t sigint_received;
 extern volatile sig_atomic_t sigabrt_received;
@@ -33,20 +179,86 @@ extern ProcessInfo *global_processes;
 extern int global_process_count;
 extern int global_processes_running;
 extern int total_elapsed_time;
+extern char *macd_cgroup_path;
+extern int macd_cgroup_cpu_enabled;
+extern int global_launches_enabled;
+extern Arena config_arena;
+extern PidTable global_pid_table;
+extern int global_cgroup_removals_pending;
+extern int *global_release_worklist;
+extern int *global_owned_indices;
+extern int global_owned_count;
+extern int global_shard_index;
+extern ShardTable global_shard_table;
 
 /// Function declarations
 void handle_sigint(int sig);
 void handle_sigabrt(int sig);
 void launch_process(ProcessInfo *process, int process_index);
 void print_start_message(int process_index, const char *message, ProcessInfo *process);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *string, size_t length);
+void arena_free(Arena *arena);
+void print_config_error(int line, int column, const char *format, ...);
+void append_token_bytes(ConfigParser *parser, const char *bytes, size_t length);
+int expand_config_variable(ConfigParser *parser);
+int next_config_token(ConfigParser *parser, int *column);
+int is_option_token(const char *raw);
+int parse_timelimit_line(ConfigParser *parser, int *timelimit, int *timelimit_line, int column);
+int parse_program_line(ConfigParser *parser, ProcessInfo **processes, int *program_count, int *capacity, int column);
+char *read_config_stream(int fd, size_t *size);
 int parse_config(const char *config_file, int *timelimit, ProcessInfo **processes, int *program_count, int *capacity);
-int validate_timelimit_line(const char *line, int *timelimit);
+int parse_process_option(ProcessInfo *process, const char *option, int line, int column);
+int compare_process_ids(const void *a, const void *b);
+void add_dependent(ProcessInfo *process, int dependent_index);
+int build_dependency_graph(ProcessInfo *processes, int *process_count);
+int start_process(ProcessInfo *processes, int *process_count, int process_index);
+void skip_process(ProcessInfo *processes, int *process_count, int process_index);
+void release_dependents(ProcessInfo *processes, int *process_count, int process_index);
+int write_cgroup_file(const char *cgroup_path, const char *file_name, const char *value);
+int get_cgroup_parent_path(char *parent_path, size_t size);
+int setup_cgroup_root();
+int create_process_cgroup(ProcessInfo *process, int process_index);
+void remove_process_cgroup(ProcessInfo *process);
+void release_process_cgroup(ProcessInfo *process);
+void retry_cgroup_removals(ProcessInfo *processes, int *process_count);
+void forget_process_cgroup(ProcessInfo *process);
+void teardown_cgroup_root();
+unsigned long long get_cgroup_cpu_usec(const char *cgroup_path);
+int needs_cpu_sample(ProcessInfo *process, int quota_only);
+int read_process_cpu_usec(pid_t pid, pid_t *pgrp, unsigned long long *cpu_usec);
+void add_group_pid(ProcessInfo *process, pid_t pid);
+void scan_process_groups(ProcessInfo *processes, int *process_count);
+void sample_cpu_usage(ProcessInfo *processes, int *process_count, int quota_only);
+void throttle_processes(ProcessInfo *processes, int *process_count);
+void insert_process_pid(ProcessInfo *processes, int *process_count, int process_index);
+ProcessInfo *find_process_by_pid(ProcessInfo *processes, int *process_count, pid_t pid);
+void reap_processes(ProcessInfo *processes, int *process_count);
+void terminate_process(ProcessInfo *process);
+int terminate_all_processes(ProcessInfo *processes, int *process_count);
 void print_usage_message();
 int file_exists(char *file_name);
-void get_process_resource_usage(int pid, int *cpu_usage, double *memory_usage);
+void update_cpu_percentages(ProcessInfo *processes, int *process_count);
+void get_process_memory_usage(int pid, double *memory_usage);
 void print_timestamp(const char *message);
+long elapsed_usec_since(const struct timespec *start);
+ProcessState get_process_state(ProcessInfo *process);
+void get_process_status(ProcessInfo *process, ProcessStatus *status);
+void print_process_status(int process_index, const ProcessStatus *status, int cpu_quota);
 void print_status_report(ProcessInfo *processes, int *process_count, const char *message);
+void build_owned_indices(ProcessInfo *processes, int *process_count);
+void launch_processes(ProcessInfo *processes, int *process_count);
 void monitor_processes(ProcessInfo *processes, int *process_count, int *timelimit);
 void cleanup_processes(ProcessInfo *processes, int *process_count);
+int find_component_root(int *parents, int index);
+void assign_shards(ProcessInfo *processes, int *process_count, int shard_count);
+void publish_shard_status(ProcessInfo *processes, int *process_count);
+void publish_process_state(ProcessInfo *process, int process_index);
+void bump_shard_heartbeat();
+void print_shard_status_report(ProcessInfo *processes, int *process_count, const char *message);
+void kill_shard_processes(ProcessInfo *processes, int *process_count, int shard);
+int reap_shards(ProcessInfo *processes, int *process_count);
+void monitor_shards(ProcessInfo *processes, int *process_count, int *timelimit);
+void run_shards(ProcessInfo *processes, int *process_count, int *timelimit, int shard_count);
 
 #endif // MACD_H
@@ -12,6 +12,20 @@
     And the following lines thereafter are a list of executable paths to be ran,
     with arguments provided (separated by spaces) after on the same line:
     /programs/build/pi_n 100
+
+    Arguments can be quoted to contain spaces, and `$VAR`/`${VAR}` expand to environment variables
+    (except inside single quotes):
+    /programs/build/echo "hello world" '$HOME is literal' $HOME
+
+    Per-process options can be given as `key=value` tokens before the executable path:
+    cpuquota=50 /programs/build/pi_n 100    // limits pi_n to 50% of one core
+    id=fetch /programs/build/fetch          // names the process so others can depend on it
+    after=fetch /programs/build/pi_n 100    // only starts once fetch has exited with status 0
+
+    `after=` takes a comma-separated list of ids. Processes whose dependencies fail are skipped.
+
+    CPU quotas are enforced with the cgroup v2 `cpu.max` controller when it is available,
+    and otherwise by stopping and continuing the process from the monitor loop.
 */
 
 #include "../include/macD.h"
@@ -24,9 +38,20 @@ ProcessInfo *global_processes = NULL;
 int global_process_count = 0;
 int global_processes_running = 0;
 int total_elapsed_time = 0;
-
-/// @brief Handles the `SIGINT` signal and terminates the program cleanly.
-/// @param sig The `SIGINT` signal value.
+char *macd_cgroup_path = NULL;
+int macd_cgroup_cpu_enabled = 0;
+int global_launches_enabled = 1;
+Arena config_arena = {0};
+PidTable global_pid_table = {0};
+int global_cgroup_removals_pending = 0;
+int *global_release_worklist = NULL;
+int *global_owned_indices = NULL;
+int global_owned_count = 0;
+int global_shard_index = -1;
+ShardTable global_shard_table = {0};
+
+/// @brief Handles the `SIGINT` (and `SIGTERM`) signal and terminates the program cleanly.
+/// @param sig The `SIGINT` or `SIGTERM` signal value.
 void handle_sigint(int sig)
 {
     if (global_processes == NULL)
@@ -62,15 +87,30 @@ void launch_process(ProcessInfo *process, int process_index)
         return;
     }
 
+    // Jobs get their own cgroup (when available) so they can be limited and killed as a unit
+    create_process_cgroup(process, process_index);
+
     pid_t pid = fork();
 
     if (pid == -1)
     {
-        exit(EXIT_FAILURE);
+        // Hitting the process limit fails this job like any other failed start, instead of orphaning the rest
+        perror("Failed to fork process");
+        remove_process_cgroup(process);
+        print_start_message(process_index, "failed to start", process);
+        process->running = 0;
+        return;
     }
     else if (pid == 0)
     { // Child process logic
       // printf("Launching process %s with args %s\n", process->program_name, *process->args);
+        // Moves into a process group and cgroup of its own before exec, so grandchildren follow it
+        setpgid(0, 0);
+        if (process->cgroup_path != NULL)
+        {
+            write_cgroup_file(process->cgroup_path, "cgroup.procs", "0");
+        }
+
         extern char **environ;
         execve(process->program_name, process->args, environ);
 
@@ -81,6 +121,19 @@ void launch_process(ProcessInfo *process, int process_index)
         global_processes_running++;
         process->pid = pid;
         process->running = 1;
+        process->kill_requested = 0;
+
+        // Also set from the parent, so the group exists whichever side runs first
+        setpgid(pid, pid);
+
+        process->cpu_usec = 0;
+        process->group_pid_count = 0;
+        process->tick_cpu_usec = 0;
+        process->report_cpu_usec = 0;
+        process->cpu_percent = 0;
+        clock_gettime(CLOCK_MONOTONIC, &process->report_time);
+        process->cpu_budget_usec = 0;
+        process->throttled = 0;
 
         int fs_buffer_size = snprintf(NULL, 0, "started successfully (pid: %d)", process->pid) + 1;
         char *formatted_string = malloc(fs_buffer_size);
@@ -134,502 +187,2391 @@ void print_start_message(int process_index, const char *message, ProcessInfo *pr
     free(args_string);
 }
 
-/// @brief ### Reads the given config file and populates the timelimit and program paths.
-/// @param config_file The path to the config file.
-/// @param timelimit A pointer to store the time limit in.
-/// @param programs An array to store program paths in.
-/// @return `0` if successful.
-int parse_config(const char *config_file, int *timelimit, ProcessInfo **processes, int *program_count, int *capacity)
+/// @brief Allocates `size` bytes from an arena, starting a new block if the current one is full.
+/// @param arena The arena to allocate from.
+/// @param size The number of bytes to allocate.
+/// @return A pointer to the allocated memory, aligned for any pointer or integer type.
+void *arena_alloc(Arena *arena, size_t size)
 {
-    FILE *file = fopen(config_file, "r");
-    if (!file)
+    size = (size + 7) & ~(size_t)7;
+
+    if (arena->head == NULL || arena->head->used + size > arena->head->size)
     {
-        perror("Failed to open configuration file");
-        exit(EXIT_FAILURE);
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock *block = malloc(sizeof(ArenaBlock) + block_size);
+        if (!block)
+        {
+            perror("Failed to allocate memory for arena block");
+            exit(EXIT_FAILURE);
+        }
+
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
     }
 
-    char *line = NULL;
-    size_t line_size = 0;
+    void *memory = arena->head->data + arena->head->used;
+    arena->head->used += size;
+    return memory;
+}
+
+/// @brief Copies the first `length` bytes of a string into an arena.
+/// @param arena The arena to allocate from.
+/// @param string The string to copy.
+/// @param length The number of bytes to copy.
+/// @return The null-terminated copy.
+char *arena_strndup(Arena *arena, const char *string, size_t length)
+{
+    char *copy = arena_alloc(arena, length + 1);
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/// @brief Frees every block of an arena at once.
+/// @param arena The arena to free.
+void arena_free(Arena *arena)
+{
+    while (arena->head != NULL)
+    {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+
+/// @brief Prints a config error to `stderr`, prefixed with where in the file it happened.
+/// @param line The line number of the error.
+/// @param column The column number of the error, or `0` if it applies to the whole line.
+/// @param format A `printf`-style format for the rest of the message.
+void print_config_error(int line, int column, const char *format, ...)
+{
+    if (column > 0)
+    {
+        fprintf(stderr, "Error: line %d, column %d: ", line, column);
+    }
+    else
+    {
+        fprintf(stderr, "Error: line %d: ", line);
+    }
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    fputc('\n', stderr);
+}
 
-    if (getline(&line, &line_size, file) != -1)
+/// @brief Appends bytes to the token currently being decoded, growing the scratch buffer if needed.
+/// @param parser The `ConfigParser` to use.
+/// @param bytes The bytes to append.
+/// @param length The number of bytes to append.
+void append_token_bytes(ConfigParser *parser, const char *bytes, size_t length)
+{
+    if (parser->token_length + length + 1 > parser->token_capacity)
     {
-        line[strcspn(line, "\n")] = 0;
+        while (parser->token_length + length + 1 > parser->token_capacity)
+        {
+            parser->token_capacity = parser->token_capacity == 0 ? 256 : parser->token_capacity * 2;
+        }
 
-        if (validate_timelimit_line(line, timelimit) != 0)
+        char *new_token = realloc(parser->token, parser->token_capacity);
+        if (!new_token)
         {
-            free(line);
-            fclose(file);
+            perror("Failed to realloc memory for token buffer");
             exit(EXIT_FAILURE);
         }
+        parser->token = new_token;
     }
-    else
+
+    memcpy(parser->token + parser->token_length, bytes, length);
+    parser->token_length += length;
+    parser->token[parser->token_length] = '\0';
+}
+
+/// @brief Expands a `$VAR` or `${VAR}` reference at the cursor into the current token.
+/// A `$` not followed by a variable name is kept as-is.
+/// @param parser The `ConfigParser` to use.
+/// @return `0` if successful, `-1` if the reference is malformed or the variable isn't set.
+int expand_config_variable(ConfigParser *parser)
+{
+    const char *dollar = parser->cursor++;
+    int column = dollar - parser->line_start + 1;
+
+    int braced = parser->cursor < parser->end && *parser->cursor == '{';
+    if (braced)
     {
-        fprintf(stderr, "Error: Failed to read timelimit line or file is empty.\n");
-        free(line);
-        fclose(file);
-        exit(EXIT_FAILURE);
+        parser->cursor++;
     }
 
-    while (getline(&line, &line_size, file) != -1)
+    const char *name = parser->cursor;
+    while (parser->cursor < parser->end && (isalnum((unsigned char)*parser->cursor) || *parser->cursor == '_'))
     {
-        // Removes newline character
-        line[strcspn(line, "\n")] = 0;
+        parser->cursor++;
+    }
+    size_t name_length = parser->cursor - name;
 
-        if (strncmp(line, "timelimit ", 10) == 0)
+    if (braced)
+    {
+        if (name_length == 0 || parser->cursor >= parser->end || *parser->cursor != '}')
         {
-            sscanf(line, "timelimit %d", timelimit);
+            print_config_error(parser->line, column, "Malformed variable reference, expected '${NAME}'.");
+            return -1;
         }
-        else if (strspn(line, " \t\r\n") != strlen(line)) // <- Checks if the line isn't empty
-        {
-            char *program_path = strtok(line, " ");
-            char *arg;
+        parser->cursor++;
+    }
+    else if (name_length == 0)
+    {
+        append_token_bytes(parser, "$", 1);
+        return 0;
+    }
 
-            // Ensures the processes array has enough capacity
-            if (*program_count >= *capacity)
-            {
-                *capacity *= 2;
-                ProcessInfo *new_processes = realloc(*processes, *capacity * sizeof(ProcessInfo));
-                if (!new_processes)
-                {
-                    perror("Failed to realloc memory for processes array");
-                    exit(EXIT_FAILURE);
-                }
-                *processes = new_processes;
-            }
+    char name_buffer[256];
+    if (name_length >= sizeof(name_buffer))
+    {
+        print_config_error(parser->line, column, "Variable name is too long.");
+        return -1;
+    }
+    memcpy(name_buffer, name, name_length);
+    name_buffer[name_length] = '\0';
 
-            ProcessInfo *current_process = &(*processes)[*program_count];
-            current_process->program_name = malloc(strlen(program_path) + 1);
-            if (!current_process->program_name)
-            {
-                perror("Failed to allocate memory for program_name");
-                exit(EXIT_FAILURE);
-            }
+    const char *value = getenv(name_buffer);
+    if (value == NULL)
+    {
+        print_config_error(parser->line, column, "Undefined variable '%s'.", name_buffer);
+        return -1;
+    }
 
-            strcpy(current_process->program_name, program_path);
+    append_token_bytes(parser, value, strlen(value));
+    return 0;
+}
 
-            int arg_index = 1;
-            size_t args_capacity = ARG_MAX;
+/// Characters that end a run of ordinary token characters, depending on the quote the tokenizer is inside
+static const unsigned char unquoted_stop_characters[256] = {[' '] = 1, ['\t'] = 1, ['\r'] = 1, ['\n'] = 1, ['"'] = 1, ['\''] = 1, ['\\'] = 1, ['$'] = 1};
+static const unsigned char double_quoted_stop_characters[256] = {['\n'] = 1, ['"'] = 1, ['\\'] = 1, ['$'] = 1};
+static const unsigned char single_quoted_stop_characters[256] = {['\n'] = 1, ['\''] = 1};
+
+/// @brief Decodes the next token on the current line into `parser->token`, handling quotes, escapes and variables.
+/// Reaching the end of the line consumes the newline and moves the parser onto the next line.
+/// @param parser The `ConfigParser` to use.
+/// @param column A pointer to store the column the token starts at.
+/// @return `1` if a token was read, `0` at the end of the line, or `-1` on a syntax error.
+int next_config_token(ConfigParser *parser, int *column)
+{
+    while (parser->cursor < parser->end && (*parser->cursor == ' ' || *parser->cursor == '\t' || *parser->cursor == '\r'))
+    {
+        parser->cursor++;
+    }
 
-            // Allocates memory to the args[] array in the ProcessInfo (max args = LINK_MAX)
-            current_process->args = malloc(args_capacity * sizeof(char *));
-            if (!current_process->args)
-            {
-                perror("Failed to allocate memory for args array");
-                exit(EXIT_FAILURE);
-            }
+    if (parser->cursor >= parser->end)
+    {
+        return 0;
+    }
+
+    if (*parser->cursor == '\n')
+    {
+        parser->cursor++;
+        parser->line++;
+        parser->line_start = parser->cursor;
+        return 0;
+    }
 
-            current_process->args[0] = strdup(current_process->program_name);
-            if (!current_process->args[0])
+    *column = parser->cursor - parser->line_start + 1;
+    parser->token_start = parser->cursor;
+    parser->token_length = 0;
+    append_token_bytes(parser, "", 0);
+
+    char quote = 0;
+    const char *quote_start = NULL;
+
+    while (parser->cursor < parser->end)
+    {
+        char c = *parser->cursor;
+
+        if (c == '\n' || (quote == 0 && (c == ' ' || c == '\t' || c == '\r')))
+        {
+            break;
+        }
+
+        if (quote == 0 && (c == '"' || c == '\''))
+        {
+            quote = c;
+            quote_start = parser->cursor++;
+        }
+        else if (quote != 0 && c == quote)
+        {
+            quote = 0;
+            parser->cursor++;
+        }
+        else if (quote != '\'' && c == '\\')
+        {
+            parser->cursor++;
+            if (parser->cursor >= parser->end || *parser->cursor == '\n')
             {
-                perror("Failed to allocate memory for program name");
-                exit(EXIT_FAILURE);
+                print_config_error(parser->line, parser->cursor - parser->line_start, "Backslash at end of line.");
+                return -1;
             }
-
-            while ((arg = strtok(NULL, " ")) != NULL)
+            append_token_bytes(parser, parser->cursor++, 1);
+        }
+        else if (quote != '\'' && c == '$')
+        {
+            if (expand_config_variable(parser) != 0)
             {
-                if (arg_index >= args_capacity)
-                {
-                    args_capacity *= 2;
-                    char **new_args = realloc(current_process->args, args_capacity * sizeof(char *));
-                    if (!new_args)
-                    {
-                        perror("Failed to realloc memory for args array");
-                        exit(EXIT_FAILURE);
-                    }
-                    current_process->args = new_args;
-                }
-                size_t len = strlen(arg);
-                while (len > 0 && isspace(arg[len - 1]))
-                {
-                    arg[--len] = '\0';
-                }
-                while (isspace(*arg))
-                {
-                    arg++;
-                }
-                current_process->args[arg_index] = malloc(strlen(arg) + 1);
-                if (!current_process->args[arg_index])
-                {
-                    perror("Failed to allocate memory for argument");
-                    exit(EXIT_FAILURE);
-                }
-                strcpy(current_process->args[arg_index], arg);
-                arg_index++;
+                return -1;
             }
-            current_process->args[arg_index] = NULL; // Null-terminates args array
-
-            (*program_count)++;
-
-            if (*program_count >= LINK_MAX)
+        }
+        else
+        {
+            // Copies the whole run of ordinary characters at once
+            const char *run = parser->cursor;
+            const unsigned char *stop_characters = quote == 0 ? unquoted_stop_characters : (quote == '"' ? double_quoted_stop_characters : single_quoted_stop_characters);
+            while (parser->cursor < parser->end && !stop_characters[(unsigned char)*parser->cursor])
             {
-                fprintf(stderr, "Too many programs in configuration file. Max allowed is %d.\n", LINK_MAX);
-                break;
+                parser->cursor++;
             }
+            append_token_bytes(parser, run, parser->cursor - run);
         }
     }
 
-    free(line);
-    fclose(file);
-    return 0;
+    if (quote != 0)
+    {
+        print_config_error(parser->line, quote_start - parser->line_start + 1, "Unterminated %s quote.", quote == '"' ? "double" : "single");
+        return -1;
+    }
+
+    return 1;
+}
+
+/// @brief Checks whether a raw token is a `key=value` process option rather than a program path.
+/// @param raw The token as it appears in the config.
+/// @return `1` if the token starts with an option key, `0` if not.
+int is_option_token(const char *raw)
+{
+    const char *key_end = raw;
+    while (isalpha((unsigned char)*key_end) || *key_end == '_')
+    {
+        key_end++;
+    }
+    return key_end > raw && *key_end == '=';
 }
 
-/// @brief Validates the format of the timelimit line in the config.
-/// @param line The line to check.
-/// @param timelimit A pointer to a timelimit value.
-/// @return
-int validate_timelimit_line(const char *line, int *timelimit)
+/// @brief Parses the value of a `timelimit <number>` line, whose keyword has already been read.
+/// @param parser The `ConfigParser` to use.
+/// @param timelimit A pointer to store the time limit in.
+/// @param timelimit_line A pointer to the line the time limit was set on (`0` if it hasn't been).
+/// @param column The column of the `timelimit` keyword.
+/// @return `0` if successful, `-1` if the line is invalid or the time limit was already set.
+int parse_timelimit_line(ConfigParser *parser, int *timelimit, int *timelimit_line, int column)
 {
-    if (strncmp(line, "timelimit ", 10) != 0)
+    int line = parser->line;
+
+    if (*timelimit_line != 0)
     {
-        fprintf(stderr, "Error: Invalid timelimit line format. Expected 'timelimit <number>'.\n");
+        print_config_error(line, column, "timelimit is already set on line %d.", *timelimit_line);
         return -1;
     }
 
-    // Extract the timelimit value
-    char *endptr;
-    long parsed_timelimit = strtol(line + 10, &endptr, 10);
+    int value_column = column;
+    if (next_config_token(parser, &value_column) != 1)
+    {
+        print_config_error(line, 0, "Invalid or missing timelimit value. Must be a positive integer.");
+        return -1;
+    }
 
     // Ensure the value is numeric and valid
-    if (*endptr != '\0' || parsed_timelimit <= 0)
+    char *endptr;
+    long parsed_timelimit = strtol(parser->token, &endptr, 10);
+    if (parser->token_length == 0 || *endptr != '\0' || parsed_timelimit <= 0 || parsed_timelimit > INT_MAX)
+    {
+        print_config_error(line, value_column, "Invalid timelimit value '%s'. Must be a positive integer.", parser->token);
+        return -1;
+    }
+
+    int extra_column;
+    int result = next_config_token(parser, &extra_column);
+    if (result == 1)
+    {
+        print_config_error(line, extra_column, "Unexpected '%s' after timelimit value.", parser->token);
+        return -1;
+    }
+    if (result == -1)
     {
-        fprintf(stderr, "Error: Invalid or missing timelimit value. Must be a positive integer.\n");
         return -1;
     }
 
     *timelimit = (int)parsed_timelimit;
+    *timelimit_line = line;
     return 0;
 }
 
-/// @brief ### Prints a program helper message to stdout.
-void print_usage_message()
+/// @brief Parses a program line (options, executable path and arguments) into a new `ProcessInfo`.
+/// The line's first token has already been read.
+/// @param parser The `ConfigParser` to use.
+/// @param processes A pointer to the processes array, which is grown as needed.
+/// @param program_count The number of processes parsed so far.
+/// @param capacity The capacity of the processes array.
+/// @param column The column of the line's first token.
+/// @return `0` if successful, `-1` on an error.
+int parse_program_line(ConfigParser *parser, ProcessInfo **processes, int *program_count, int *capacity, int column)
 {
-    fprintf(stdout, "Usage: ./macD -i [config file]\n");
-}
+    int line = parser->line;
 
-/// @brief ### Checks if a given file exists in the local path.
-/// @param file_name The name of the file to check for.
-/// @return `0` if the file is found, `1` if not.
-int file_exists(char *file_name)
-{
-    if (access(file_name, F_OK) == 0)
+    // Ensures the processes array has enough capacity
+    if (*program_count >= *capacity)
     {
-        return 0;
+        *capacity *= 2;
+        ProcessInfo *new_processes = realloc(*processes, *capacity * sizeof(ProcessInfo));
+        if (!new_processes)
+        {
+            perror("Failed to realloc memory for processes array");
+            exit(EXIT_FAILURE);
+        }
+        *processes = new_processes;
     }
-    return 1;
-}
 
-/// @brief Populates `*cpu_usage` and `*memory_usage` pointers with the current resource usage values of process `pid`.
-/// @param pid The pid of the process to check.
-/// @param cpu_usage A pointer to store the CPU utilization value in.
-/// @param memory_usage A pointer to store the memory usage value in.
-void get_process_resource_usage(int pid, int *cpu_usage, double *memory_usage)
-{
-    *cpu_usage = 0;
-    *memory_usage = 0.0;
+    ProcessInfo *current_process = &(*processes)[*program_count];
+    memset(current_process, 0, sizeof(ProcessInfo));
+    current_process->config_line = line;
 
-    // Allocates memory dynamically for file paths
-    size_t path_size = snprintf(NULL, 0, "/proc/%d/stat", pid) + 1;
-    char *stat_path = malloc(path_size);
-    if (!stat_path)
+    // Consumes any leading `key=value` options before the executable path
+    int result = 1;
+    while (result == 1 && is_option_token(parser->token_start))
     {
-        perror("Failed to allocate memory for stat_path");
-        return;
+        if (parse_process_option(current_process, parser->token, line, column) != 0)
+        {
+            return -1;
+        }
+        result = next_config_token(parser, &column);
     }
-    snprintf(stat_path, path_size, "/proc/%d/stat", pid);
 
-    path_size = snprintf(NULL, 0, "/proc/%d/statm", pid) + 1;
-    char *statm_path = malloc(path_size);
-    if (!statm_path)
+    if (result == -1)
     {
-        perror("Failed to allocate memory for statm_path");
-        free(stat_path);
-        return;
+        return -1;
     }
-    snprintf(statm_path, path_size, "/proc/%d/statm", pid);
-
-    // Checks if the process exists
-    if (kill(pid, 0) != 0)
+    if (result == 0)
     {
-        free(stat_path);
-        free(statm_path);
-        return;
+        print_config_error(line, 0, "Missing program path after options.");
+        return -1;
     }
 
-    // Opens /proc/[pid]/stat for CPU usage
-    FILE *stat_file = fopen(stat_path, "r");
-    if (!stat_file)
+    current_process->program_name = arena_strndup(&config_arena, parser->token, parser->token_length);
+
+    // Collects the args in scratch space first, so the arena copy is exactly the right size
+    parser->arg_count = 0;
+    do
     {
-        fprintf(stderr, "Warning: Unable to open %s (process may have terminated).\n", stat_path);
-        free(stat_path);
-        free(statm_path);
-        return;
-    }
+        if (parser->arg_count + 1 >= parser->args_capacity)
+        {
+            parser->args_capacity = parser->args_capacity == 0 ? INITIAL_ARGS_CAPACITY : parser->args_capacity * 2;
+            char **new_args = realloc(parser->args, parser->args_capacity * sizeof(char *));
+            if (!new_args)
+            {
+                perror("Failed to realloc memory for args array");
+                exit(EXIT_FAILURE);
+            }
+            parser->args = new_args;
+        }
 
-    size_t line_size = 1024;
-    char *line = malloc(line_size);
-    if (!line)
+        // args[0] shares the program name's copy
+        parser->args[parser->arg_count] = parser->arg_count == 0 ? current_process->program_name
+                                                                 : arena_strndup(&config_arena, parser->token, parser->token_length);
+        parser->arg_count++;
+    } while ((result = next_config_token(parser, &column)) == 1);
+
+    if (result == -1)
     {
-        perror("Failed to allocate memory for line buffer");
-        fclose(stat_file);
-        free(stat_path);
-        free(statm_path);
-        return;
+        return -1;
     }
 
-    if (fgets(line, line_size, stat_file) != NULL)
+    current_process->args = arena_alloc(&config_arena, (parser->arg_count + 1) * sizeof(char *));
+    memcpy(current_process->args, parser->args, parser->arg_count * sizeof(char *));
+    current_process->args[parser->arg_count] = NULL; // Null-terminates args array
+
+    (*program_count)++;
+    return 0;
+}
+
+/// @brief Reads everything from a config file that can't be mapped, such as a pipe or `/dev/stdin`.
+/// @param fd The open config file.
+/// @param size A pointer to store the number of bytes read in.
+/// @return A buffer holding the contents, to be released with `free`.
+char *read_config_stream(int fd, size_t *size)
+{
+    size_t capacity = 65536;
+    char *data = malloc(capacity);
+    if (!data)
     {
-        // Parses fields using dynamic allocation
-        char **fields = malloc(LINK_MAX * sizeof(char *));
-        if (!fields)
-        {
-            perror("Failed to allocate memory for fields array");
-            fclose(stat_file);
-            free(line);
-            free(stat_path);
-            free(statm_path);
-            return;
-        }
+        perror("Failed to allocate memory for configuration file");
+        exit(EXIT_FAILURE);
+    }
 
-        int field_index = 0;
-        char *token = strtok(line, " ");
-        while (token != NULL)
+    *size = 0;
+    while (1)
+    {
+        if (*size == capacity)
         {
-            fields[field_index] = malloc(strlen(token) + 1);
-            if (!fields[field_index])
+            capacity *= 2;
+            char *grown = realloc(data, capacity);
+            if (!grown)
             {
-                perror("Failed to allocate memory for field token");
-                for (int i = 0; i < field_index; i++)
-                {
-                    free(fields[i]);
-                }
-                free(fields);
-                fclose(stat_file);
-                free(line);
-                free(stat_path);
-                free(statm_path);
-                return;
+                perror("Failed to allocate memory for configuration file");
+                exit(EXIT_FAILURE);
             }
-            strcpy(fields[field_index++], token);
-            token = strtok(NULL, " ");
+            data = grown;
         }
 
-        unsigned long utime = strtoul(fields[13], NULL, 10);
-        unsigned long stime = strtoul(fields[14], NULL, 10);
-        unsigned long starttime = strtoul(fields[21], NULL, 10);
-        unsigned long total_time = utime + stime;
-
-        long clock_ticks_per_sec = sysconf(_SC_CLK_TCK);
-
-        double uptime;
-        FILE *uptime_file = fopen("/proc/uptime", "r");
-        if (uptime_file)
+        ssize_t bytes_read = read(fd, data + *size, capacity - *size);
+        if (bytes_read == 0)
         {
-            fscanf(uptime_file, "%lf", &uptime);
-            fclose(uptime_file);
+            break;
         }
-        else
+        if (bytes_read < 0)
         {
-            fprintf(stderr, "Warning: Unable to read /proc/uptime.\n");
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("Failed to read configuration file");
+            exit(EXIT_FAILURE);
         }
+        *size += bytes_read;
+    }
 
-        unsigned long long elapsed_time = (unsigned long long)(uptime * clock_ticks_per_sec) - starttime;
+    return data;
+}
 
-        if (elapsed_time > 0)
-        {
-            *cpu_usage = (total_time * 100) / elapsed_time;
-        }
+/// @brief ### Reads the given config file and populates the timelimit and program paths.
+/// Regular files are mapped into memory and anything else (pipes, FIFOs, `/dev/stdin`) is read into a buffer,
+/// then tokenized in a single pass, with every string stored in `config_arena`.
+/// @param config_file The path to the config file.
+/// @param timelimit A pointer to store the time limit in.
+/// @param programs An array to store program paths in.
+/// @return `0` if successful.
+int parse_config(const char *config_file, int *timelimit, ProcessInfo **processes, int *program_count, int *capacity)
+{
+    int fd = open(config_file, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("Failed to open configuration file");
+        exit(EXIT_FAILURE);
+    }
 
-        // Frees allocated memory for fields
-        for (int i = 0; i < field_index; i++)
-        {
-            free(fields[i]);
-        }
-        free(fields);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        perror("Failed to read configuration file");
+        exit(EXIT_FAILURE);
     }
 
-    fclose(stat_file);
+    // The size of anything but a regular file isn't known until it has been read
+    int mapped = S_ISREG(file_stat.st_mode);
+    size_t data_size = mapped ? (size_t)file_stat.st_size : 0;
+    char *data = NULL;
 
-    // Opens /proc/[pid]/statm for memory usage
-    FILE *statm_file = fopen(statm_path, "r");
-    if (!statm_file)
+    if (!mapped)
     {
-        fprintf(stderr, "Warning: Unable to open %s (process may have terminated).\n", statm_path);
-        free(line);
-        free(stat_path);
-        free(statm_path);
-        return;
+        data = read_config_stream(fd, &data_size);
     }
 
-    if (fgets(line, line_size, statm_file) != NULL)
+    if (data_size == 0)
+    {
+        fprintf(stderr, "Error: Failed to read timelimit line or file is empty.\n");
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+
+    if (mapped)
+    {
+        data = mmap(NULL, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            perror("Failed to map configuration file");
+            exit(EXIT_FAILURE);
+        }
+        madvise(data, data_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    ConfigParser parser = {0};
+    parser.cursor = data;
+    parser.end = data + data_size;
+    parser.line_start = data;
+    parser.line = 1;
+
+    int timelimit_line = 0;
+    int failed = 0;
+
+    while (parser.cursor < parser.end && !failed)
+    {
+        int line = parser.line;
+        int column = 1;
+        int result = next_config_token(&parser, &column);
+
+        if (result == -1)
+        {
+            failed = 1;
+        }
+        else if (line == 1 && (result == 0 || strncmp(parser.token_start, "timelimit", 9) != 0 || strcmp(parser.token, "timelimit") != 0))
+        {
+            // The first line must set the time limit
+            print_config_error(line, 0, "Invalid timelimit line format. Expected 'timelimit <number>'.");
+            failed = 1;
+        }
+        else if (result == 1 && strncmp(parser.token_start, "timelimit", 9) == 0 && strcmp(parser.token, "timelimit") == 0)
+        {
+            failed = parse_timelimit_line(&parser, timelimit, &timelimit_line, column) != 0;
+        }
+        else if (result == 1)
+        {
+            failed = parse_program_line(&parser, processes, program_count, capacity, column) != 0;
+
+            if (!failed && *program_count >= MAX_PROCESSES)
+            {
+                fprintf(stderr, "Too many programs in configuration file. Max allowed is %d.\n", MAX_PROCESSES);
+                break;
+            }
+        }
+    }
+
+    if (mapped)
+    {
+        munmap(data, data_size);
+    }
+    else
+    {
+        free(data);
+    }
+    free(parser.token);
+    free(parser.args);
+
+    if (failed)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    if (build_dependency_graph(*processes, program_count) != 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    return 0;
+}
+
+/// @brief Parses a single `key=value` process option from the config.
+/// @param process The `ProcessInfo` to apply the option to.
+/// @param option The option token (e.g. `cpuquota=50`).
+/// @param line The line the option is on, for error messages.
+/// @param column The column the option starts at, for error messages.
+/// @return `0` if successful, `-1` if the option is unknown or invalid.
+int parse_process_option(ProcessInfo *process, const char *option, int line, int column)
+{
+    if (strncmp(option, "cpuquota=", 9) == 0)
+    {
+        // Accepts both `cpuquota=50` and `cpuquota=50%`
+        char *endptr;
+        long parsed_quota = strtol(option + 9, &endptr, 10);
+        if (*endptr == '%')
+        {
+            endptr++;
+        }
+
+        // sysconf() reads sysfs on every call, which adds up over a large config
+        static long cpu_count = 0;
+        if (cpu_count == 0)
+        {
+            cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+
+        if (endptr == option + 9 || *endptr != '\0' || parsed_quota <= 0 || parsed_quota > 100 * cpu_count)
+        {
+            print_config_error(line, column, "Invalid cpuquota value '%s'. Must be a positive percentage of one core.", option + 9);
+            return -1;
+        }
+
+        process->cpu_quota = (int)parsed_quota;
+        return 0;
+    }
+
+    if (strncmp(option, "id=", 3) == 0 || strncmp(option, "after=", 6) == 0)
+    {
+        int is_id = option[0] == 'i';
+        const char *value = strchr(option, '=') + 1;
+
+        if (*value == '\0')
+        {
+            print_config_error(line, column, "Missing value for process option '%s'.", option);
+            return -1;
+        }
+
+        // `after=` splits on commas, so an id containing one could never be depended on
+        if (is_id && strchr(value, ',') != NULL)
+        {
+            print_config_error(line, column, "Invalid id '%s'. Ids can't contain ','.", value);
+            return -1;
+        }
+
+        if (!is_id && (value[0] == ',' || value[strlen(value) - 1] == ',' || strstr(value, ",,") != NULL))
+        {
+            print_config_error(line, column, "Empty id in '%s'.", option);
+            return -1;
+        }
+
+        char **field = is_id ? &process->id : &process->after;
+        *field = arena_strndup(&config_arena, value, strlen(value));
+        return 0;
+    }
+
+    print_config_error(line, column, "Unknown process option '%s'.", option);
+    return -1;
+}
+
+/// @brief Compares two `ProcessId` entries by id, for `qsort` and `bsearch`.
+int compare_process_ids(const void *a, const void *b)
+{
+    return strcmp(((const ProcessId *)a)->id, ((const ProcessId *)b)->id);
+}
+
+/// @brief Records that `dependent_index` has to wait for `process` to exit successfully.
+/// @param process The predecessor `ProcessInfo`.
+/// @param dependent_index The index of the process waiting on it.
+void add_dependent(ProcessInfo *process, int dependent_index)
+{
+    if (process->dependent_count >= process->dependent_capacity)
+    {
+        process->dependent_capacity = process->dependent_capacity == 0 ? 4 : process->dependent_capacity * 2;
+        int *new_dependents = realloc(process->dependents, process->dependent_capacity * sizeof(int));
+        if (!new_dependents)
+        {
+            perror("Failed to realloc memory for dependents array");
+            exit(EXIT_FAILURE);
+        }
+        process->dependents = new_dependents;
+    }
+
+    process->dependents[process->dependent_count++] = dependent_index;
+}
+
+/// @brief Resolves the `after=` ids of every process into dependency edges, and checks the result is acyclic.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @return `0` if successful, `-1` if an id is duplicated, unknown, or part of a cycle.
+int build_dependency_graph(ProcessInfo *processes, int *process_count)
+{
+    int id_count = 0;
+    ProcessId *ids = malloc((*process_count + 1) * sizeof(ProcessId));
+    if (!ids)
+    {
+        perror("Failed to allocate memory for process ids");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < *process_count; i++)
+    {
+        if (processes[i].id != NULL)
+        {
+            ids[id_count].id = processes[i].id;
+            ids[id_count].index = i;
+            id_count++;
+        }
+    }
+
+    // Sorts the ids so duplicates are adjacent and lookups are a binary search
+    qsort(ids, id_count, sizeof(ProcessId), compare_process_ids);
+    for (int i = 1; i < id_count; i++)
+    {
+        if (strcmp(ids[i - 1].id, ids[i].id) == 0)
+        {
+            print_config_error(processes[ids[i].index].config_line, 0, "Duplicate process id '%s' (first used on line %d).", ids[i].id, processes[ids[i - 1].index].config_line);
+            free(ids);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < *process_count; i++)
+    {
+        if (processes[i].after == NULL)
+        {
+            continue;
+        }
+
+        char *after = strdup(processes[i].after);
+        if (!after)
+        {
+            perror("Failed to allocate memory for after list");
+            exit(EXIT_FAILURE);
+        }
+
+        char *save_pointer;
+        for (char *id = strtok_r(after, ",", &save_pointer); id != NULL; id = strtok_r(NULL, ",", &save_pointer))
+        {
+            ProcessId key = {.id = id};
+            ProcessId *match = bsearch(&key, ids, id_count, sizeof(ProcessId), compare_process_ids);
+            if (match == NULL)
+            {
+                print_config_error(processes[i].config_line, 0, "Process [%d] depends on unknown id '%s'.", i, id);
+                free(after);
+                free(ids);
+                return -1;
+            }
+
+            add_dependent(&processes[match->index], i);
+            processes[i].waiting_on++;
+        }
+
+        free(after);
+    }
+
+    free(ids);
+
+    // Kahn's algorithm: if not every process can be ordered, the rest are part of (or behind) a cycle
+    int *remaining = malloc((*process_count + 1) * sizeof(int));
+    int *queue = malloc((*process_count + 1) * sizeof(int));
+    if (!remaining || !queue)
+    {
+        perror("Failed to allocate memory for dependency check");
+        exit(EXIT_FAILURE);
+    }
+
+    int queue_head = 0;
+    int queue_tail = 0;
+    for (int i = 0; i < *process_count; i++)
+    {
+        remaining[i] = processes[i].waiting_on;
+        if (remaining[i] == 0)
+        {
+            queue[queue_tail++] = i;
+        }
+    }
+
+    while (queue_head < queue_tail)
+    {
+        ProcessInfo *process = &processes[queue[queue_head++]];
+        for (int i = 0; i < process->dependent_count; i++)
+        {
+            if (--remaining[process->dependents[i]] == 0)
+            {
+                queue[queue_tail++] = process->dependents[i];
+            }
+        }
+    }
+
+    int result = 0;
+    if (queue_tail < *process_count)
+    {
+        for (int i = 0; i < *process_count; i++)
+        {
+            if (remaining[i] > 0)
+            {
+                print_config_error(processes[i].config_line, 0, "Dependency cycle involving process [%d].", i);
+                break;
+            }
+        }
+        result = -1;
+    }
+
+    free(remaining);
+    free(queue);
+    return result;
+}
+
+/// @brief ### Prints a program helper message to stdout.
+void print_usage_message()
+{
+    fprintf(stdout, "Usage: ./macD -i [config file] [--shards N]\n");
+}
+
+/// @brief ### Checks if a given file exists in the local path.
+/// @param file_name The name of the file to check for.
+/// @return `0` if the file is found, `1` if not.
+int file_exists(char *file_name)
+{
+    if (access(file_name, F_OK) == 0)
+    {
+        return 0;
+    }
+    return 1;
+}
+
+/// @brief Writes a value to a control file inside a cgroup directory.
+/// @param cgroup_path The path to the cgroup directory.
+/// @param file_name The control file to write to (e.g. `cpu.max`).
+/// @param value The string to write.
+/// @return `0` if successful, `-1` if not.
+int write_cgroup_file(const char *cgroup_path, const char *file_name, const char *value)
+{
+    char file_path[PATH_MAX];
+    snprintf(file_path, sizeof(file_path), "%s/%s", cgroup_path, file_name);
+
+    int fd = open(file_path, O_WRONLY);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    ssize_t written = write(fd, value, strlen(value));
+    close(fd);
+
+    return written == (ssize_t)strlen(value) ? 0 : -1;
+}
+
+/// @brief Finds the cgroup v2 directory macD itself is running in.
+/// @param parent_path A buffer to store the path in.
+/// @param size The size of the buffer.
+/// @return `0` if successful, `-1` if cgroups are unavailable on this system.
+int get_cgroup_parent_path(char *parent_path, size_t size)
+{
+    // Finds where the unified (v2) hierarchy is mounted
+    const char *mount_points[] = {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"};
+    const char *mount_point = NULL;
+    for (size_t i = 0; i < sizeof(mount_points) / sizeof(mount_points[0]); i++)
+    {
+        char controllers_path[PATH_MAX];
+        snprintf(controllers_path, sizeof(controllers_path), "%s/cgroup.controllers", mount_points[i]);
+        if (access(controllers_path, F_OK) == 0)
+        {
+            mount_point = mount_points[i];
+            break;
+        }
+    }
+
+    if (mount_point == NULL)
+    {
+        return -1;
+    }
+
+    // Finds the cgroup macD itself is running in (the `0::` line)
+    char own_cgroup[PATH_MAX] = "";
+    FILE *cgroup_file = fopen("/proc/self/cgroup", "r");
+    if (!cgroup_file)
+    {
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, cgroup_file) != -1)
+    {
+        if (strncmp(line, "0::", 3) == 0)
+        {
+            line[strcspn(line, "\n")] = 0;
+            strncpy(own_cgroup, line + 3, sizeof(own_cgroup) - 1);
+            own_cgroup[sizeof(own_cgroup) - 1] = '\0';
+            break;
+        }
+    }
+    free(line);
+    fclose(cgroup_file);
+
+    snprintf(parent_path, size, "%s%s", mount_point, strcmp(own_cgroup, "/") == 0 ? "" : own_cgroup);
+    return 0;
+}
+
+/// @brief Creates a cgroup v2 directory for macD to place its processes in, delegating the `cpu` controller if possible.
+/// @return `0` if successful, `-1` if cgroups are unavailable on this system.
+int setup_cgroup_root()
+{
+    if (macd_cgroup_path != NULL)
+    {
+        return 0;
+    }
+
+    char parent_path[PATH_MAX];
+    if (get_cgroup_parent_path(parent_path, sizeof(parent_path)) != 0)
+    {
+        return -1;
+    }
+
+    char root_path[PATH_MAX + 32];
+    snprintf(root_path, sizeof(root_path), "%s/macD-%d", parent_path, getpid());
+
+    if (mkdir(root_path, 0755) != 0 && errno != EEXIST)
+    {
+        return -1;
+    }
+
+    macd_cgroup_path = strdup(root_path);
+    if (!macd_cgroup_path)
+    {
+        perror("Failed to allocate memory for macd_cgroup_path");
+        exit(EXIT_FAILURE);
+    }
+
+    // Only succeeds if macD's own cgroup already has cpu in its subtree_control. Since cgroup v2 doesn't allow
+    // that in a non-root cgroup with processes in it (macD is one), this in practice means macD runs in the
+    // root cgroup; macD never changes the parent's configuration, and falls back to signal-driven throttling instead
+    macd_cgroup_cpu_enabled = write_cgroup_file(root_path, "cgroup.subtree_control", "+cpu") == 0;
+
+    return 0;
+}
+
+/// @brief Creates a cgroup for a single process and applies its CPU quota to it, if it has one.
+/// @param process The `ProcessInfo` to create a cgroup for.
+/// @param process_index The index of the process in the global processes list.
+/// @return `0` if successful, `-1` if the process has to run without a cgroup of its own.
+int create_process_cgroup(ProcessInfo *process, int process_index)
+{
+    if (macd_cgroup_path == NULL)
+    {
+        return -1;
+    }
+
+    char cgroup_path[PATH_MAX];
+    snprintf(cgroup_path, sizeof(cgroup_path), "%s/job-%d", macd_cgroup_path, process_index);
+
+    if (mkdir(cgroup_path, 0755) != 0 && errno != EEXIST)
+    {
+        return -1;
+    }
+
+    process->cgroup_path = strdup(cgroup_path);
+    if (!process->cgroup_path)
+    {
+        perror("Failed to allocate memory for cgroup_path");
+        exit(EXIT_FAILURE);
+    }
+
+    // Quotas that can't be written to `cpu.max` are enforced by throttle_processes() instead
+    if (process->cpu_quota > 0 && macd_cgroup_cpu_enabled)
+    {
+        char cpu_max[64];
+        long quota_usec = (long)process->cpu_quota * CPU_QUOTA_PERIOD_USEC / 100;
+        snprintf(cpu_max, sizeof(cpu_max), "%ld %d", quota_usec, CPU_QUOTA_PERIOD_USEC);
+
+        process->cgroup_quota = write_cgroup_file(cgroup_path, "cpu.max", cpu_max) == 0;
+    }
+
+    return 0;
+}
+
+/// @brief Removes the cgroup of a process, killing anything the process left behind in it.
+/// Blocks for a bounded time while those leftovers die, so this is only used outside the monitor loop.
+/// @param process The `ProcessInfo` whose cgroup should be removed.
+void remove_process_cgroup(ProcessInfo *process)
+{
+    if (process->cgroup_path == NULL)
+    {
+        return;
+    }
+
+    for (int attempt = 0; rmdir(process->cgroup_path) != 0; attempt++)
+    {
+        if (errno != EBUSY || attempt >= CGROUP_REMOVE_ATTEMPTS)
+        {
+            fprintf(stderr, "Warning: Unable to remove cgroup %s.\n", process->cgroup_path);
+            break;
+        }
+
+        // The cgroup is still populated by grandchildren of the process
+        write_cgroup_file(process->cgroup_path, "cgroup.kill", "1");
+        usleep(CGROUP_REMOVE_RETRY_USEC);
+    }
+
+    forget_process_cgroup(process);
+}
+
+/// @brief Starts removing the cgroup of a process that has been reaped, without blocking.
+/// Anything the process left running in its cgroup (e.g. a daemonized grandchild) is killed, and
+/// the removal is finished by retry_cgroup_removals() on a later tick once those are gone.
+/// @param process The `ProcessInfo` whose cgroup should be removed.
+void release_process_cgroup(ProcessInfo *process)
+{
+    if (process->cgroup_path == NULL || process->cgroup_removal_pending)
+    {
+        return;
+    }
+
+    if (rmdir(process->cgroup_path) == 0)
+    {
+        forget_process_cgroup(process);
+        return;
+    }
+
+    if (errno != EBUSY)
+    {
+        fprintf(stderr, "Warning: Unable to remove cgroup %s.\n", process->cgroup_path);
+        forget_process_cgroup(process);
+        return;
+    }
+
+    write_cgroup_file(process->cgroup_path, "cgroup.kill", "1");
+    process->cgroup_removal_pending = 1;
+    global_cgroup_removals_pending++;
+}
+
+/// @brief Retries removing the cgroups release_process_cgroup() couldn't remove straight away.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void retry_cgroup_removals(ProcessInfo *processes, int *process_count)
+{
+    for (int k = 0; k < global_owned_count && global_cgroup_removals_pending > 0; k++)
+    {
+        int i = global_owned_indices[k];
+        if (processes[i].cgroup_removal_pending && rmdir(processes[i].cgroup_path) == 0)
+        {
+            forget_process_cgroup(&processes[i]);
+        }
+    }
+}
+
+/// @brief Frees the cgroup path of a process whose cgroup has been removed (or given up on).
+/// @param process The `ProcessInfo` whose cgroup is gone.
+void forget_process_cgroup(ProcessInfo *process)
+{
+    if (process->cgroup_removal_pending)
+    {
+        process->cgroup_removal_pending = 0;
+        global_cgroup_removals_pending--;
+    }
+
+    free(process->cgroup_path);
+    process->cgroup_path = NULL;
+    process->cgroup_quota = 0;
+}
+
+/// @brief Kills anything still inside macD's own cgroup and removes it, if one was created.
+void teardown_cgroup_root()
+{
+    if (macd_cgroup_path == NULL)
+    {
+        return;
+    }
+
+    write_cgroup_file(macd_cgroup_path, "cgroup.kill", "1");
+
+    // Killed processes can take a moment to leave the cgroup, so this waits up to the teardown timeout
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (rmdir(macd_cgroup_path) != 0 && errno == EBUSY && elapsed_usec_since(&start) < TEARDOWN_TIMEOUT_USEC)
+    {
+        usleep(CGROUP_REMOVE_RETRY_USEC);
+    }
+
+    free(macd_cgroup_path);
+    macd_cgroup_path = NULL;
+}
+
+/// @brief Reads the CPU time used by everything that has ever run in a cgroup.
+/// @param cgroup_path The directory of the cgroup.
+/// @return The CPU time in microseconds, or `0` if it couldn't be read.
+unsigned long long get_cgroup_cpu_usec(const char *cgroup_path)
+{
+    char stat_path[PATH_MAX];
+    snprintf(stat_path, sizeof(stat_path), "%s/cpu.stat", cgroup_path);
+
+    FILE *stat_file = fopen(stat_path, "r");
+    if (!stat_file)
+    {
+        return 0;
+    }
+
+    char line[256];
+    unsigned long long usage_usec = 0;
+
+    while (fgets(line, sizeof(line), stat_file) != NULL)
+    {
+        if (sscanf(line, "usage_usec %llu", &usage_usec) == 1)
+        {
+            break;
+        }
+    }
+
+    fclose(stat_file);
+    return usage_usec;
+}
+
+/// @brief Checks whether a process' CPU time should be refreshed by sample_cpu_usage().
+/// @param process The `ProcessInfo` to check.
+/// @param quota_only Whether only processes whose quota is enforced by throttle_processes() need it.
+/// @return `1` if it should be sampled, `0` otherwise.
+int needs_cpu_sample(ProcessInfo *process, int quota_only)
+{
+    return process->running && (!quota_only || (process->cpu_quota > 0 && !process->cgroup_quota));
+}
+
+/// @brief Reads the CPU time used by a single process, including the children it has already reaped.
+/// @param pid The pid of the process to check.
+/// @param pgrp A pointer to store the process group of the process in.
+/// @param cpu_usec A pointer to store the CPU time (in microseconds) in.
+/// @return `0` if successful, `-1` if the process is gone.
+int read_process_cpu_usec(pid_t pid, pid_t *pgrp, unsigned long long *cpu_usec)
+{
+    static long clock_ticks_per_sec = 0;
+    if (clock_ticks_per_sec == 0)
+    {
+        clock_ticks_per_sec = sysconf(_SC_CLK_TCK);
+    }
+
+    char stat_path[32];
+    snprintf(stat_path, sizeof(stat_path), "/proc/%d/stat", pid);
+
+    // Called for every member of every throttled process group on each tick, so this avoids stdio
+    int fd = open(stat_path, O_RDONLY);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    char line[1024];
+    ssize_t length = read(fd, line, sizeof(line) - 1);
+    close(fd);
+    if (length <= 0)
+    {
+        return -1;
+    }
+    line[length] = '\0';
+
+    int group = 0;
+    unsigned long utime = 0;
+    unsigned long stime = 0;
+    long cutime = 0;
+    long cstime = 0;
+
+    // Skips past the command name, which may itself contain spaces
+    char *fields = strrchr(line, ')');
+    if (fields == NULL ||
+        sscanf(fields + 2, "%*c %*d %d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %ld %ld",
+               &group, &utime, &stime, &cutime, &cstime) != 5)
+    {
+        return -1;
+    }
+
+    *pgrp = group;
+    *cpu_usec = (unsigned long long)(utime + stime + cutime + cstime) * 1000000 / clock_ticks_per_sec;
+    return 0;
+}
+
+/// @brief Records a pid as a member of a process' group, for sample_cpu_usage() to read on later ticks.
+/// @param process The `ProcessInfo` leading the group.
+/// @param pid The pid of the member.
+void add_group_pid(ProcessInfo *process, pid_t pid)
+{
+    if (process->group_pid_count >= process->group_pid_capacity)
+    {
+        process->group_pid_capacity = process->group_pid_capacity == 0 ? 4 : process->group_pid_capacity * 2;
+        pid_t *new_group_pids = realloc(process->group_pids, process->group_pid_capacity * sizeof(pid_t));
+        if (!new_group_pids)
+        {
+            perror("Failed to realloc memory for group pids");
+            exit(EXIT_FAILURE);
+        }
+        process->group_pids = new_group_pids;
+    }
+
+    process->group_pids[process->group_pid_count++] = pid;
+}
+
+/// @brief Rebuilds the member list and `cpu_usec` of every running process without a cgroup, in a single pass over `/proc`.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void scan_process_groups(ProcessInfo *processes, int *process_count)
+{
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        ProcessInfo *process = &processes[global_owned_indices[k]];
+        if (!process->running || process->cgroup_path != NULL)
+        {
+            continue;
+        }
+
+        // The leader stays in its group until it's reaped, so it's always a member
+        pid_t pgrp;
+        process->group_pid_count = 0;
+        process->cpu_usec = 0;
+        add_group_pid(process, process->pid);
+        read_process_cpu_usec(process->pid, &pgrp, &process->cpu_usec);
+    }
+
+    DIR *proc_dir = opendir("/proc");
+    if (!proc_dir)
+    {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(proc_dir)) != NULL)
+    {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9')
+        {
+            continue;
+        }
+
+        pid_t pid = (pid_t)atoi(entry->d_name);
+        pid_t pgrp;
+        unsigned long long cpu_usec;
+        if (read_process_cpu_usec(pid, &pgrp, &cpu_usec) != 0 || pid == pgrp)
+        {
+            continue; // Exited since the directory was listed, or a leader already counted above
+        }
+
+        // Every process group macD creates is led by the process it launched
+        ProcessInfo *process = find_process_by_pid(processes, process_count, pgrp);
+        if (process == NULL || process->cgroup_path != NULL)
+        {
+            continue;
+        }
+
+        add_group_pid(process, pid);
+        process->cpu_usec += cpu_usec;
+    }
+
+    closedir(proc_dir);
+}
+
+/// @brief Refreshes `cpu_usec` for running processes, counting everything they spawned as well.
+/// Processes with a cgroup are read from its `cpu.stat`. The rest are summed over their process group (including
+/// children already reaped inside it): members are found by a pass over `/proc` at most every `CPU_GROUP_SCAN_USEC`,
+/// and only those members are read on the ticks in between.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param quota_only Whether to sample only the processes whose quota is enforced by throttle_processes().
+void sample_cpu_usage(ProcessInfo *processes, int *process_count, int quota_only)
+{
+    static struct timespec last_scan;
+    static int scanned = 0;
+
+    int scan_needed = 0;
+    int members_needed = 0;
+
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        ProcessInfo *process = &processes[global_owned_indices[k]];
+        if (!needs_cpu_sample(process, quota_only))
+        {
+            continue;
+        }
+
+        if (process->cgroup_path != NULL)
+        {
+            process->cpu_usec = get_cgroup_cpu_usec(process->cgroup_path);
+        }
+        else if (process->group_pid_count == 0)
+        {
+            scan_needed = 1; // Launched since the last pass
+        }
+        else
+        {
+            members_needed = 1;
+        }
+    }
+
+    if (members_needed && (!scanned || elapsed_usec_since(&last_scan) >= CPU_GROUP_SCAN_USEC))
+    {
+        scan_needed = 1;
+    }
+
+    if (scan_needed)
+    {
+        scan_process_groups(processes, process_count);
+        clock_gettime(CLOCK_MONOTONIC, &last_scan);
+        scanned = 1;
+        return;
+    }
+
+    if (!members_needed)
+    {
+        return;
+    }
+
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        ProcessInfo *process = &processes[global_owned_indices[k]];
+        if (!needs_cpu_sample(process, quota_only) || process->cgroup_path != NULL)
+        {
+            continue;
+        }
+
+        // Members that have exited or left the group since the last pass are simply not counted
+        process->cpu_usec = 0;
+        for (int k = 0; k < process->group_pid_count; k++)
+        {
+            pid_t pgrp;
+            unsigned long long cpu_usec;
+            if (read_process_cpu_usec(process->group_pids[k], &pgrp, &cpu_usec) == 0 && pgrp == process->pid)
+            {
+                process->cpu_usec += cpu_usec;
+            }
+        }
+    }
+}
+
+/// @brief Runs one tick of the duty-cycle scheduler, stopping processes that have spent their CPU budget
+/// and continuing those that have earned it back.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void throttle_processes(ProcessInfo *processes, int *process_count)
+{
+    sample_cpu_usage(processes, process_count, 1);
+
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        ProcessInfo *process = &processes[global_owned_indices[k]];
+        if (!process->running || process->cpu_quota <= 0 || process->cgroup_quota)
+        {
+            continue;
+        }
+
+        // The total can shrink when a process leaves the group, which isn't negative usage
+        long used_usec = 0;
+        if (process->cpu_usec > process->tick_cpu_usec)
+        {
+            used_usec = (long)(process->cpu_usec - process->tick_cpu_usec);
+        }
+        process->tick_cpu_usec = process->cpu_usec;
+
+        // Earns `cpu_quota`% of each tick, and never banks more than one second's worth
+        long earned_usec = (long)process->cpu_quota * MONITOR_TICK_USEC / 100;
+        long max_budget_usec = earned_usec * MONITOR_TICKS_PER_SECOND;
+
+        process->cpu_budget_usec += earned_usec - used_usec;
+        if (process->cpu_budget_usec > max_budget_usec)
+        {
+            process->cpu_budget_usec = max_budget_usec;
+        }
+
+        if (process->cpu_budget_usec < 0 && !process->throttled)
+        {
+            kill(-process->pid, SIGSTOP);
+            process->throttled = 1;
+        }
+        else if (process->cpu_budget_usec >= 0 && process->throttled)
+        {
+            kill(-process->pid, SIGCONT);
+            process->throttled = 0;
+        }
+    }
+}
+
+/// @brief Works out the CPU usage of each running process since the previous status report.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void update_cpu_percentages(ProcessInfo *processes, int *process_count)
+{
+    sample_cpu_usage(processes, process_count, 0);
+
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        ProcessInfo *process = &processes[global_owned_indices[k]];
+        if (!process->running)
+        {
+            continue;
+        }
+
+        long elapsed_usec = elapsed_usec_since(&process->report_time);
+
+        process->cpu_percent = 0;
+        if (elapsed_usec > 0 && process->cpu_usec > process->report_cpu_usec)
+        {
+            process->cpu_percent = (int)((process->cpu_usec - process->report_cpu_usec) * 100 / elapsed_usec);
+        }
+
+        process->report_cpu_usec = process->cpu_usec;
+        clock_gettime(CLOCK_MONOTONIC, &process->report_time);
+    }
+}
+
+/// @brief Populates `*memory_usage` with the resident memory of process `pid`.
+/// @param pid The pid of the process to check.
+/// @param memory_usage A pointer to store the memory usage value in.
+void get_process_memory_usage(int pid, double *memory_usage)
+{
+    *memory_usage = 0.0;
+
+    // Allocates memory dynamically for file paths
+    size_t path_size = snprintf(NULL, 0, "/proc/%d/statm", pid) + 1;
+    char *statm_path = malloc(path_size);
+    if (!statm_path)
+    {
+        perror("Failed to allocate memory for statm_path");
+        return;
+    }
+    snprintf(statm_path, path_size, "/proc/%d/statm", pid);
+
+    // Checks if the process exists
+    if (kill(pid, 0) != 0)
+    {
+        free(statm_path);
+        return;
+    }
+
+    size_t line_size = 1024;
+    char *line = malloc(line_size);
+    if (!line)
+    {
+        perror("Failed to allocate memory for line buffer");
+        free(statm_path);
+        return;
+    }
+
+    // Opens /proc/[pid]/statm for memory usage
+    FILE *statm_file = fopen(statm_path, "r");
+    if (!statm_file)
+    {
+        fprintf(stderr, "Warning: Unable to open %s (process may have terminated).\n", statm_path);
+        free(line);
+        free(statm_path);
+        return;
+    }
+
+    if (fgets(line, line_size, statm_file) != NULL)
     {
         char *size_field = strtok(line, " ");
         char *resident_field = strtok(NULL, " ");
         if (size_field && resident_field)
         {
-            unsigned long total_pages = strtoul(size_field, NULL, 10);
-            unsigned long resident_pages = strtoul(resident_field, NULL, 10);
+            unsigned long resident_pages = strtoul(resident_field, NULL, 10);
+
+            int page_size = getpagesize();
+
+            double resident_memory_mb = (resident_pages * page_size) / (1024.0 * 1024.0);
+
+            *memory_usage = resident_memory_mb;
+        }
+    }
+
+    fclose(statm_file);
+
+    // Frees dynamically allocated memory
+    free(line);
+    free(statm_path);
+}
+
+/// @brief Prints a timestamp message to the screen.
+/// @param message The beginning of the message.
+void print_timestamp(const char *message)
+{
+    time_t current_time = time(NULL);
+    struct tm *local_time = localtime(&current_time);
+
+    char formatted_time[64];
+    strftime(formatted_time, sizeof(formatted_time), "%a, %b %d, %Y %I:%M:%S %p", local_time);
+
+    fprintf(stdout, "%s, %s\n", message, formatted_time);
+}
+
+/// @brief Measures how much time has passed since `start`.
+/// @param start A `CLOCK_MONOTONIC` time.
+/// @return The elapsed time in microseconds.
+long elapsed_usec_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/// @brief Prints a status report to `stdout`.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void print_status_report(ProcessInfo *processes, int *process_count, const char *message)
+{
+    update_cpu_percentages(processes, process_count);
+
+    // Shard workers hand their state to the coordinator, which prints the unified report
+    if (global_shard_index >= 0)
+    {
+        publish_shard_status(processes, process_count);
+        return;
+    }
+
+    print_timestamp(message);
+
+    for (int i = 0; i < *process_count; i++)
+    {
+        ProcessStatus status;
+        get_process_status(&processes[i], &status);
+        print_process_status(i, &status, processes[i].cpu_quota);
+    }
+}
+
+/// @brief Works out which state a process is in, as shown in status reports.
+/// @param process The `ProcessInfo` to check.
+/// @return The state of the process.
+ProcessState get_process_state(ProcessInfo *process)
+{
+    if (process->running)
+    {
+        return PROCESS_RUNNING;
+    }
+    else if (process->was_terminated)
+    {
+        return PROCESS_TERMINATED;
+    }
+    else if (process->skipped)
+    {
+        return PROCESS_SKIPPED;
+    }
+    else if (!process->started)
+    {
+        // Once the timelimit or a shutdown has stopped new launches, a process still waiting will never run
+        return global_launches_enabled ? PROCESS_WAITING : PROCESS_SKIPPED;
+    }
+    return PROCESS_EXITED;
+}
+
+/// @brief Takes a snapshot of a process' state, sampling its resource usage if it's running.
+/// @param process The `ProcessInfo` to check.
+/// @param status A pointer to store the snapshot in.
+void get_process_status(ProcessInfo *process, ProcessStatus *status)
+{
+    status->pid = process->pid;
+    status->state = get_process_state(process);
+    status->cpu_usage = 0;
+    status->memory_usage = 0.0;
+
+    if (process->running)
+    {
+        status->cpu_usage = process->cpu_percent;
+        get_process_memory_usage(process->pid, &status->memory_usage);
+    }
+}
+
+/// @brief Prints a single process' line of a status report to `stdout`.
+/// @param process_index The index of the process in the global processes list.
+/// @param status The snapshot of the process to print.
+/// @param cpu_quota The CPU quota of the process (0 = unlimited).
+void print_process_status(int process_index, const ProcessStatus *status, int cpu_quota)
+{
+    switch (status->state)
+    {
+    case PROCESS_RUNNING:
+        if (cpu_quota > 0)
+        {
+            fprintf(stdout, "[%d] Running, cpu usage: %d%% (quota: %d%%), mem usage: %.2f MB\n", process_index, status->cpu_usage, cpu_quota, status->memory_usage);
+        }
+        else
+        {
+            fprintf(stdout, "[%d] Running, cpu usage: %d%%, mem usage: %.2f MB\n", process_index, status->cpu_usage, status->memory_usage);
+        }
+        break;
+    case PROCESS_TERMINATED:
+        fprintf(stdout, "[%d] Terminated\n", process_index);
+        break;
+    case PROCESS_SKIPPED:
+        fprintf(stdout, "[%d] Skipped\n", process_index);
+        break;
+    case PROCESS_WAITING:
+        fprintf(stdout, "[%d] Waiting\n", process_index);
+        break;
+    default:
+        fprintf(stdout, "[%d] Exited\n", process_index);
+        break;
+    }
+}
+
+/// @brief Lists the processes this macD supervises (the ones its shard owns in `--shards` mode, otherwise all of them),
+/// so the per-tick loops cost O(its own slice) rather than O(the whole config).
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void build_owned_indices(ProcessInfo *processes, int *process_count)
+{
+    global_owned_indices = malloc((*process_count + 1) * sizeof(int));
+    if (!global_owned_indices)
+    {
+        perror("Failed to allocate memory for owned process list");
+        exit(EXIT_FAILURE);
+    }
+
+    global_owned_count = 0;
+    for (int i = 0; i < *process_count; i++)
+    {
+        if (global_shard_index < 0 || processes[i].shard == global_shard_index)
+        {
+            global_owned_indices[global_owned_count++] = i;
+        }
+    }
+}
+
+/// @brief Launches every process that doesn't depend on another, stopping early if a shutdown signal arrives.
+/// In `--shards` mode, only the processes owned by this shard are launched.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void launch_processes(ProcessInfo *processes, int *process_count)
+{
+    struct timespec last_reap;
+    clock_gettime(CLOCK_MONOTONIC, &last_reap);
+
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        int i = global_owned_indices[k];
+
+        if (sigint_received || sigabrt_received)
+        {
+            break;
+        }
+
+        // Launching thousands of roots takes a while, so processes that finish meanwhile are reaped
+        // on the monitor's schedule and their dependents started without waiting for the last root
+        if (elapsed_usec_since(&last_reap) >= MONITOR_TICK_USEC)
+        {
+            reap_processes(processes, process_count);
+            clock_gettime(CLOCK_MONOTONIC, &last_reap);
+        }
+
+        // Processes with dependencies are started by release_dependents() once those have exited successfully
+        if (processes[i].waiting_on == 0 && !processes[i].started && !processes[i].skipped)
+        {
+            if (!start_process(processes, process_count, i))
+            {
+                release_dependents(processes, process_count, i);
+            }
+        }
+    }
+}
+
+/// @brief Launches a process whose dependencies have all succeeded, marking it as failed if it doesn't start.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param process_index The index of the process to start.
+/// @return `1` if the process is running, `0` if it failed to start (its dependents still have to be released).
+int start_process(ProcessInfo *processes, int *process_count, int process_index)
+{
+    ProcessInfo *process = &processes[process_index];
+    process->started = 1;
+
+    // Launching a large slice can take longer than the stall timeout, so every launch counts as progress
+    bump_shard_heartbeat();
+    launch_process(process, process_index);
+    publish_process_state(process, process_index);
+
+    if (process->running)
+    {
+        insert_process_pid(processes, process_count, process_index);
+        return 1;
+    }
+
+    process->failed = 1;
+    return 0;
+}
+
+/// @brief Marks a process as never running because one of its dependencies failed. Its dependents still have to be released.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param process_index The index of the process to skip.
+void skip_process(ProcessInfo *processes, int *process_count, int process_index)
+{
+    ProcessInfo *process = &processes[process_index];
+    process->skipped = 1;
+
+    print_start_message(process_index, "skipped (dependency failed)", process);
+    publish_process_state(process, process_index);
+}
+
+/// @brief Starts the dependents of a finished process that are no longer waiting on anything, or skips them if it failed.
+/// Dependents that are skipped or fail to start are released in turn through a worklist rather than by recursing,
+/// since a failure at the root of a long chain would otherwise recurse once per process in it.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param process_index The index of the process that finished.
+void release_dependents(ProcessInfo *processes, int *process_count, int process_index)
+{
+    // A process is pushed only once it has been started or skipped, which happens at most once, so this never overflows
+    if (global_release_worklist == NULL)
+    {
+        global_release_worklist = malloc(*process_count * sizeof(int));
+        if (!global_release_worklist)
+        {
+            perror("Failed to allocate memory for dependency worklist");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int pending = 0;
+    global_release_worklist[pending++] = process_index;
+
+    while (pending > 0)
+    {
+        ProcessInfo *process = &processes[global_release_worklist[--pending]];
+
+        for (int i = 0; i < process->dependent_count; i++)
+        {
+            int dependent_index = process->dependents[i];
+            ProcessInfo *dependent = &processes[dependent_index];
+
+            if (dependent->started || dependent->skipped)
+            {
+                continue;
+            }
+
+            if (process->failed || process->skipped)
+            {
+                skip_process(processes, process_count, dependent_index);
+                global_release_worklist[pending++] = dependent_index;
+            }
+            else if (--dependent->waiting_on == 0 && global_launches_enabled &&
+                     !start_process(processes, process_count, dependent_index))
+            {
+                global_release_worklist[pending++] = dependent_index;
+            }
+        }
+    }
+}
+
+/// @brief Records a launched process in the pid table, so the reaper can find it without scanning.
+/// @param processes The `ProcessInfo` the table indexes into.
+/// @param process_count The number of processes.
+/// @param process_index The index of the process that was just launched.
+void insert_process_pid(ProcessInfo *processes, int *process_count, int process_index)
+{
+    // Every process is launched at most once, so a table of twice that size never fills up
+    if (global_pid_table.slots == NULL)
+    {
+        global_pid_table.capacity = 16;
+        while (global_pid_table.capacity < *process_count * 2)
+        {
+            global_pid_table.capacity *= 2;
+        }
+
+        global_pid_table.slots = calloc(global_pid_table.capacity, sizeof(int));
+        if (!global_pid_table.slots)
+        {
+            perror("Failed to allocate memory for pid table");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    unsigned int slot = ((unsigned int)processes[process_index].pid * 2654435761u) & (global_pid_table.capacity - 1);
+    while (global_pid_table.slots[slot] != 0)
+    {
+        slot = (slot + 1) & (global_pid_table.capacity - 1);
+    }
+    global_pid_table.slots[slot] = process_index + 1;
+}
+
+/// @brief Finds the running process with the given pid.
+/// @param processes The `ProcessInfo` to search.
+/// @param process_count The number of processes.
+/// @param pid The pid to look for.
+/// @return A pointer to the matching `ProcessInfo`, or `NULL` if there isn't one.
+ProcessInfo *find_process_by_pid(ProcessInfo *processes, int *process_count, pid_t pid)
+{
+    if (global_pid_table.slots == NULL)
+    {
+        return NULL;
+    }
+
+    // Entries are never removed, so a reused pid may also match an earlier process that has exited
+    unsigned int slot = ((unsigned int)pid * 2654435761u) & (global_pid_table.capacity - 1);
+    while (global_pid_table.slots[slot] != 0)
+    {
+        ProcessInfo *process = &processes[global_pid_table.slots[slot] - 1];
+        if (process->running && process->pid == pid)
+        {
+            return process;
+        }
+        slot = (slot + 1) & (global_pid_table.capacity - 1);
+    }
+    return NULL;
+}
+
+/// @brief Reaps every child process that has finished, without blocking.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+void reap_processes(ProcessInfo *processes, int *process_count)
+{
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        ProcessInfo *process = find_process_by_pid(processes, process_count, pid);
+        if (process == NULL)
+        {
+            continue;
+        }
+
+        process->running = 0;
+        global_processes_running--;
+
+        if (WIFEXITED(status)) // Exited normally
+        {
+            process->was_terminated = 0;
+        }
+        else if (WIFSIGNALED(status)) // Terminated by signal
+        {
+            process->was_terminated = 1;
+        }
+
+        process->failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+        publish_process_state(process, process - processes);
+        release_process_cgroup(process);
+        release_dependents(processes, process_count, process - processes);
+    }
+}
+
+/// @brief Sends `SIGKILL` to a process along with everything it spawned. Does not wait for it to die.
+/// @param process The `ProcessInfo` to terminate.
+void terminate_process(ProcessInfo *process)
+{
+    if (process->cgroup_path != NULL)
+    {
+        write_cgroup_file(process->cgroup_path, "cgroup.kill", "1");
+    }
+
+    kill(-process->pid, SIGKILL);
+    process->kill_requested = 1;
+}
+
+/// @brief Kills every running process in a single pass, then reaps them until they're gone or `TEARDOWN_TIMEOUT_USEC` passes.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @return The number of processes that didn't die in time.
+int terminate_all_processes(ProcessInfo *processes, int *process_count)
+{
+    global_launches_enabled = 0;
+
+    // A single write kills every process in macD's cgroup, grandchildren included
+    if (macd_cgroup_path != NULL)
+    {
+        write_cgroup_file(macd_cgroup_path, "cgroup.kill", "1");
+    }
+
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        int i = global_owned_indices[k];
+        if (processes[i].running && !processes[i].kill_requested)
+        {
+            kill(-processes[i].pid, SIGKILL);
+            processes[i].kill_requested = 1;
+        }
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    reap_processes(processes, process_count);
+    while (global_processes_running > 0 && elapsed_usec_since(&start) < TEARDOWN_TIMEOUT_USEC)
+    {
+        usleep(TEARDOWN_POLL_USEC);
+        reap_processes(processes, process_count);
+    }
+
+    int survivors = 0;
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        int i = global_owned_indices[k];
+        if (processes[i].running)
+        {
+            fprintf(stderr, "[%d] Did not terminate (pid: %d)\n", i, processes[i].pid);
+            survivors++;
+        }
+    }
+
+    return survivors;
+}
+
+/// @brief Monitors actively-running processes and occasionally prints a status report on each.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param timelimit The maximum time limit the running processes have to finish executing.
+void monitor_processes(ProcessInfo *processes, int *process_count, int *timelimit)
+{
+    global_processes = processes;
+    global_process_count = *process_count;
+
+    int tick = 0;
+
+    while (1)
+    {
+        if (sigint_received || sigabrt_received)
+        {
+            terminate_all_processes(global_processes, &global_process_count);
+            print_status_report(global_processes, process_count, "Signal Received - Terminating");
+            if (global_shard_index < 0)
+            {
+                fprintf(stdout, "Exiting (total time: %d seconds)\n", total_elapsed_time);
+            }
+            break;
+        }
+
+        usleep(MONITOR_TICK_USEC);
+        reap_processes(processes, process_count);
+        retry_cgroup_removals(processes, process_count);
+        throttle_processes(processes, process_count);
+        bump_shard_heartbeat();
+
+        if (global_processes_running == 0)
+        {
+            print_status_report(processes, process_count, "Terminating");
+            if (global_shard_index < 0)
+            {
+                fprintf(stdout, "Exiting (total time: %d seconds)\n", total_elapsed_time);
+            }
+            break;
+        }
 
-            int page_size = getpagesize();
+        // Everything below only runs once per second
+        if (++tick < MONITOR_TICKS_PER_SECOND)
+        {
+            continue;
+        }
+        tick = 0;
+        total_elapsed_time += 1;
 
-            double total_memory_mb = (total_pages * page_size) / (1024.0 * 1024.0);
-            double resident_memory_mb = (resident_pages * page_size) / (1024.0 * 1024.0);
+        // Timed-out processes are killed here and reaped on a later tick
+        if (total_elapsed_time >= *timelimit)
+        {
+            global_launches_enabled = 0;
 
-            *memory_usage = resident_memory_mb;
+            for (int k = 0; k < global_owned_count; k++)
+            {
+                int i = global_owned_indices[k];
+                if (processes[i].running && !processes[i].kill_requested)
+                {
+                    terminate_process(&processes[i]);
+                }
+            }
+        }
+
+        if (total_elapsed_time % 5 == 0 || global_shard_index >= 0)
+        {
+            print_status_report(processes, process_count, "Normal report");
         }
     }
+}
 
-    fclose(statm_file);
+/// @brief Cleans up memory of child processes.
+/// @param processes The processes to free.
+/// @param process_count The number of processes.
+void cleanup_processes(ProcessInfo *processes, int *process_count)
+{
+    for (int i = 0; i < *process_count; i++)
+    {
+        remove_process_cgroup(&processes[i]);
+        free(processes[i].dependents);
+        free(processes[i].group_pids);
+    }
 
-    // Frees dynamically allocated memory
-    free(line);
-    free(stat_path);
-    free(statm_path);
+    free(global_pid_table.slots);
+    global_pid_table.slots = NULL;
+    free(global_release_worklist);
+    global_release_worklist = NULL;
+    free(global_owned_indices);
+    global_owned_indices = NULL;
+    global_owned_count = 0;
+
+    // Program names, args and options all live in the config arena
+    arena_free(&config_arena);
+
+    // Frees the processes array itself (this was being really annoying lol)
+    free(processes);
 }
 
-/// @brief Prints a timestamp message to the screen.
-/// @param message The beginning of the message.
-void print_timestamp(const char *message)
+/// @brief Finds the representative of a dependency component, compressing the path as it goes.
+/// @param parents The union-find parent of each process.
+/// @param index The index of the process to look up.
+/// @return The index of the component's representative.
+int find_component_root(int *parents, int index)
 {
-    time_t current_time = time(NULL);
-    struct tm *local_time = localtime(&current_time);
+    while (parents[index] != index)
+    {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
 
-    char formatted_time[64];
-    strftime(formatted_time, sizeof(formatted_time), "%a, %b %d, %Y %I:%M:%S %p", local_time);
+/// @brief Splits the processes between `shard_count` shards, keeping every dependency component on one shard
+/// so `after=` never has to cross between workers.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param shard_count The number of shards to split the processes between.
+void assign_shards(ProcessInfo *processes, int *process_count, int shard_count)
+{
+    int *parents = malloc((*process_count + 1) * sizeof(int));
+    int *component_sizes = calloc(*process_count + 1, sizeof(int));
+    int *component_shards = malloc((*process_count + 1) * sizeof(int));
+    if (!parents || !component_sizes || !component_shards)
+    {
+        perror("Failed to allocate memory for shard assignment");
+        exit(EXIT_FAILURE);
+    }
 
-    fprintf(stdout, "%s, %s\n", message, formatted_time);
+    for (int i = 0; i < *process_count; i++)
+    {
+        parents[i] = i;
+        component_shards[i] = -1;
+    }
+
+    for (int i = 0; i < *process_count; i++)
+    {
+        for (int j = 0; j < processes[i].dependent_count; j++)
+        {
+            int a = find_component_root(parents, i);
+            int b = find_component_root(parents, processes[i].dependents[j]);
+            if (a != b)
+            {
+                parents[b] = a;
+            }
+        }
+    }
+
+    for (int i = 0; i < *process_count; i++)
+    {
+        component_sizes[find_component_root(parents, i)]++;
+    }
+
+    // Hands each component to the least-loaded shard, in config order
+    for (int i = 0; i < *process_count; i++)
+    {
+        int root = find_component_root(parents, i);
+        if (component_shards[root] == -1)
+        {
+            int least_loaded = 0;
+            for (int k = 1; k < shard_count; k++)
+            {
+                if (global_shard_table.shards[k].process_count < global_shard_table.shards[least_loaded].process_count)
+                {
+                    least_loaded = k;
+                }
+            }
+
+            component_shards[root] = least_loaded;
+            global_shard_table.shards[least_loaded].process_count += component_sizes[root];
+        }
+
+        processes[i].shard = component_shards[root];
+    }
+
+    free(parents);
+    free(component_sizes);
+    free(component_shards);
 }
 
-/// @brief Prints a status report to `stdout`.
+/// @brief Writes the state of every process this shard owns to the shared table.
 /// @param processes The `ProcessInfo` to use.
 /// @param process_count The number of processes.
-void print_status_report(ProcessInfo *processes, int *process_count, const char *message)
+void publish_shard_status(ProcessInfo *processes, int *process_count)
+{
+    for (int k = 0; k < global_owned_count; k++)
+    {
+        int i = global_owned_indices[k];
+
+        // Launches, skips and reaps are published as they happen, so only usage (and waiting processes that
+        // became skipped when launches stopped) still needs refreshing here
+        ProcessState state = get_process_state(&processes[i]);
+        if (state == PROCESS_RUNNING || state != global_shard_table.processes[i].state)
+        {
+            get_process_status(&processes[i], &global_shard_table.processes[i]);
+        }
+    }
+}
+
+/// @brief Tells the coordinator this shard worker is still making progress.
+void bump_shard_heartbeat()
+{
+    if (global_shard_index >= 0)
+    {
+        global_shard_table.shards[global_shard_index].heartbeat++;
+    }
+}
+
+/// @brief Writes a process' pid and state to the shared table as soon as it changes, without waiting for the
+/// next report, so the coordinator can kill it even if this worker is stopped or dies before then.
+/// Resource usage is only filled in by publish_shard_status().
+/// @param process The `ProcessInfo` that was launched, skipped or reaped.
+/// @param process_index The index of the process in the global processes list.
+void publish_process_state(ProcessInfo *process, int process_index)
+{
+    if (global_shard_index < 0)
+    {
+        return;
+    }
+
+    ProcessStatus *status = &global_shard_table.processes[process_index];
+    status->pid = process->pid;
+
+    // The coordinator only trusts the pid of a row it sees as running, so the pid has to land first
+    __sync_synchronize();
+    status->state = get_process_state(process);
+
+    if (!process->running)
+    {
+        status->cpu_usage = 0;
+        status->memory_usage = 0.0;
+    }
+}
+
+/// @brief Prints a status report for every process across all shards to `stdout`, from the shared table.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param message The beginning of the report's timestamp message.
+void print_shard_status_report(ProcessInfo *processes, int *process_count, const char *message)
 {
     print_timestamp(message);
 
     for (int i = 0; i < *process_count; i++)
     {
-        if (processes[i].running)
+        print_process_status(i, &global_shard_table.processes[i], processes[i].cpu_quota);
+    }
+}
+
+/// @brief Kills the processes a dead or stalled shard worker left running, and removes its cgroups.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @param shard The index of the shard.
+void kill_shard_processes(ProcessInfo *processes, int *process_count, int shard)
+{
+    for (int i = 0; i < *process_count; i++)
+    {
+        ProcessStatus *status = &global_shard_table.processes[i];
+        // A pid of 0 would signal the coordinator's own process group
+        if (processes[i].shard == shard && status->state == PROCESS_RUNNING && status->pid > 0)
         {
-            int cpu_usage = 0;
-            double memory_usage = 0.0;
-            get_process_resource_usage(processes[i].pid, &cpu_usage, &memory_usage);
-            fprintf(stdout, "[%d] Running, cpu usage: %d%%, mem usage: %.2f MB\n", i, cpu_usage, memory_usage);
+            kill(-status->pid, SIGKILL);
+            status->state = PROCESS_TERMINATED;
         }
-        else if (processes[i].was_terminated)
+        else if (processes[i].shard == shard && status->state == PROCESS_WAITING)
         {
-            fprintf(stdout, "[%d] Terminated\n", i);
+            status->state = PROCESS_SKIPPED; // Nothing is left to launch it
         }
-        else
+    }
+
+    // The worker's cgroups sit next to where the coordinator's own would be
+    char parent_path[PATH_MAX];
+    if (macd_cgroup_path != NULL || get_cgroup_parent_path(parent_path, sizeof(parent_path)) != 0)
+    {
+        return;
+    }
+
+    char root_path[PATH_MAX + 32];
+    snprintf(root_path, sizeof(root_path), "%s/macD-%d", parent_path, global_shard_table.shards[shard].pid);
+    if (access(root_path, F_OK) != 0)
+    {
+        return;
+    }
+
+    write_cgroup_file(root_path, "cgroup.kill", "1");
+    for (int i = 0; i < *process_count; i++)
+    {
+        char cgroup_path[PATH_MAX + 64];
+        snprintf(cgroup_path, sizeof(cgroup_path), "%s/job-%d", root_path, i);
+        if (processes[i].shard == shard && access(cgroup_path, F_OK) == 0)
         {
-            fprintf(stdout, "[%d] Exited\n", i);
+            processes[i].cgroup_path = strdup(cgroup_path);
+            if (!processes[i].cgroup_path)
+            {
+                perror("Failed to allocate memory for cgroup_path");
+                exit(EXIT_FAILURE);
+            }
+            remove_process_cgroup(&processes[i]);
         }
     }
+
+    // The coordinator has no cgroup of its own, so it can borrow teardown_cgroup_root() for the worker's
+    macd_cgroup_path = strdup(root_path);
+    if (!macd_cgroup_path)
+    {
+        perror("Failed to allocate memory for macd_cgroup_path");
+        exit(EXIT_FAILURE);
+    }
+    teardown_cgroup_root();
 }
 
-/// @brief Monitors actively-running processes and occasionally prints a status report on each.
+/// @brief Reaps every shard worker that has exited, without blocking.
+/// @param processes The `ProcessInfo` to use.
+/// @param process_count The number of processes.
+/// @return The number of shard workers still running.
+int reap_shards(ProcessInfo *processes, int *process_count)
+{
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (int k = 0; k < global_shard_table.shard_count; k++)
+        {
+            ShardInfo *shard = &global_shard_table.shards[k];
+            if (shard->pid != pid)
+            {
+                continue;
+            }
+
+            shard->exited = 1;
+
+            // A worker that didn't exit cleanly can't be trusted to have cleaned up after itself
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            {
+                fprintf(stderr, "Warning: Shard %d (pid: %d) exited abnormally.\n", k, pid);
+                kill_shard_processes(processes, process_count, k);
+            }
+        }
+    }
+
+    int shards_running = 0;
+    for (int k = 0; k < global_shard_table.shard_count; k++)
+    {
+        if (!global_shard_table.shards[k].exited)
+        {
+            shards_running++;
+        }
+    }
+
+    return shards_running;
+}
+
+/// @brief Watches the shard workers, printing unified status reports and forwarding shutdown signals to them.
 /// @param processes The `ProcessInfo` to use.
 /// @param process_count The number of processes.
 /// @param timelimit The maximum time limit the running processes have to finish executing.
-void monitor_processes(ProcessInfo *processes, int *process_count, int *timelimit)
+void monitor_shards(ProcessInfo *processes, int *process_count, int *timelimit)
 {
-    global_processes = processes;
-    global_process_count = *process_count;
+    int tick = 0;
 
     while (1)
     {
         if (sigint_received || sigabrt_received)
         {
-            for (int i = 0; i < global_process_count; i++)
+            int forwarded_signal = sigabrt_received ? SIGABRT : SIGINT;
+            for (int k = 0; k < global_shard_table.shard_count; k++)
             {
-                if (global_processes[i].running)
+                if (!global_shard_table.shards[k].exited)
                 {
-                    kill(global_processes[i].pid, SIGKILL);
-                    global_processes[i].running = 0;
-                    global_processes[i].was_terminated = 1;
+                    kill(global_shard_table.shards[k].pid, forwarded_signal);
                 }
             }
-            print_status_report(global_processes, process_count, "Signal Received - Terminating");
-            fprintf(stdout, "Exiting (total time: %d seconds)\n", total_elapsed_time);
-            break;
-        }
-
-        sleep(1);
-        total_elapsed_time += 1;
 
-        for (int i = 0; i < *process_count; i++)
-        {
-            if (processes[i].running)
+            // Gives the workers their own teardown window, plus a second to report back
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            while (reap_shards(processes, process_count) > 0 && elapsed_usec_since(&start) < TEARDOWN_TIMEOUT_USEC + 1000000)
             {
-                int status;
-                pid_t result = waitpid(processes[i].pid, &status, WNOHANG);
+                usleep(TEARDOWN_POLL_USEC);
+            }
 
-                if (result > 0) // Process has finished
-                {
-                    processes[i].running = 0;
-                    global_processes_running--;
-
-                    if (WIFEXITED(status)) // Exited normally
-                    {
-                        processes[i].running = 0;
-                        processes[i].was_terminated = 0;
-                    }
-                    else if (WIFSIGNALED(status)) // Terminated by signal
-                    {
-                        processes[i].running = 0;
-                        processes[i].was_terminated = 1;
-                    }
-                }
-                else if (total_elapsed_time >= *timelimit && processes[i].running)
+            for (int k = 0; k < global_shard_table.shard_count; k++)
+            {
+                ShardInfo *shard = &global_shard_table.shards[k];
+                if (!shard->exited)
                 {
-                    kill(processes[i].pid, SIGKILL);
-                    waitpid(processes[i].pid, &status, 0);
-                    processes[i].running = 0;
-                    processes[i].was_terminated = 1; // Explicitly terminated due to timeout
-                    global_processes_running--;
+                    fprintf(stderr, "Warning: Shard %d (pid: %d) did not exit, killing it.\n", k, shard->pid);
+                    kill(shard->pid, SIGKILL);
+                    waitpid(shard->pid, NULL, 0);
+                    shard->exited = 1;
+                    kill_shard_processes(processes, process_count, k);
                 }
             }
+
+            print_shard_status_report(processes, process_count, "Signal Received - Terminating");
+            fprintf(stdout, "Exiting (total time: %d seconds)\n", total_elapsed_time);
+            break;
         }
 
-        if (global_processes_running == 0)
+        usleep(MONITOR_TICK_USEC);
+
+        if (reap_shards(processes, process_count) == 0)
         {
-            print_status_report(processes, process_count, "Terminating");
+            print_shard_status_report(processes, process_count, "Terminating");
             fprintf(stdout, "Exiting (total time: %d seconds)\n", total_elapsed_time);
             break;
         }
 
+        // Everything below only runs once per second
+        if (++tick < MONITOR_TICKS_PER_SECOND)
+        {
+            continue;
+        }
+        tick = 0;
+        total_elapsed_time += 1;
+
+        for (int k = 0; k < global_shard_table.shard_count; k++)
+        {
+            ShardInfo *shard = &global_shard_table.shards[k];
+            if (shard->exited)
+            {
+                continue;
+            }
+
+            if (shard->heartbeat != shard->last_heartbeat)
+            {
+                shard->last_heartbeat = shard->heartbeat;
+                shard->stalled_seconds = 0;
+                continue;
+            }
+
+            shard->stalled_seconds++;
+            if (shard->stalled_seconds == SHARD_STALL_SECONDS)
+            {
+                fprintf(stderr, "Warning: Shard %d (pid: %d) stalled.\n", k, shard->pid);
+            }
+
+            // A stalled worker can't enforce the timelimit on its own processes, so the coordinator does
+            if (shard->stalled_seconds >= SHARD_STALL_SECONDS && total_elapsed_time >= *timelimit + SHARD_STALL_SECONDS)
+            {
+                kill(shard->pid, SIGKILL);
+            }
+        }
+
         if (total_elapsed_time % 5 == 0)
         {
-            print_status_report(processes, process_count, "Normal report");
+            print_shard_status_report(processes, process_count, "Normal report");
         }
     }
 }
 
-/// @brief Cleans up memory of child processes.
-/// @param processes The processes to free.
+/// @brief Runs macD as a coordinator over `shard_count` worker supervisors, each launching and monitoring
+/// its own slice of the processes and publishing their state through a shared-memory table.
+/// @param processes The `ProcessInfo` to use.
 /// @param process_count The number of processes.
-void cleanup_processes(ProcessInfo *processes, int *process_count)
+/// @param timelimit The maximum time limit the running processes have to finish executing.
+/// @param shard_count The number of worker supervisors to fork.
+void run_shards(ProcessInfo *processes, int *process_count, int *timelimit, int shard_count)
 {
-    for (int i = 0; i < *process_count; i++)
+    // Process rows come first so their doubles stay aligned
+    size_t table_size = *process_count * sizeof(ProcessStatus) + shard_count * sizeof(ShardInfo);
+    void *table = mmap(NULL, table_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED)
     {
-        if (processes[i].program_name)
-        {
-            free(processes[i].program_name);
-            processes[i].program_name = NULL;
-        }
+        perror("Failed to map shared memory for shard table");
+        exit(EXIT_FAILURE);
+    }
+
+    global_shard_table.shard_count = shard_count;
+    global_shard_table.processes = table;
+    global_shard_table.shards = (ShardInfo *)(global_shard_table.processes + *process_count);
+
+    assign_shards(processes, process_count, shard_count);
+
+    // Anything still buffered would otherwise be printed again by every worker
+    fflush(stdout);
+
+    for (int k = 0; k < shard_count; k++)
+    {
+        pid_t pid = fork();
 
-        if (processes[i].args)
+        if (pid == -1)
         {
-            for (int j = 0; processes[i].args[j] != NULL; j++)
+            perror("Failed to fork shard worker");
+            for (int j = 0; j < k; j++)
             {
-                free(processes[i].args[j]);
+                kill(global_shard_table.shards[j].pid, SIGINT);
             }
-            free(processes[i].args);
-            processes[i].args = NULL;
+            exit(EXIT_FAILURE);
+        }
+        else if (pid == 0)
+        { // Shard worker logic
+            global_shard_index = k;
+
+            // Keeps start messages from different workers from interleaving mid-line
+            setvbuf(stdout, NULL, _IOLBF, 0);
+
+            setup_cgroup_root();
+            build_owned_indices(processes, process_count);
+            launch_processes(processes, process_count);
+            monitor_processes(processes, process_count, timelimit);
+
+            cleanup_processes(processes, process_count);
+            teardown_cgroup_root();
+            exit(EXIT_SUCCESS);
         }
+
+        global_shard_table.shards[k].pid = pid;
     }
 
-    // Frees the processes array itself (this was being really annoying lol)
-    free(processes);
+    monitor_shards(processes, process_count, timelimit);
+
+    munmap(table, table_size);
 }
 
 /// @brief ### The main entry point of macD.
@@ -639,16 +2581,20 @@ void cleanup_processes(ProcessInfo *processes, int *process_count)
 int main(int argc, char *argv[])
 {
     signal(SIGINT, handle_sigint);
+
+    // Processes run in their own process groups, so a SIGTERM that only reached macD would orphan them
+    signal(SIGTERM, handle_sigint);
     signal(SIGABRT, handle_sigabrt);
 
     // Prints a usage message if we don't receive the proper number of arguments, then terminates.
-    if (argc != 3)
+    if (argc < 3)
     {
         print_usage_message();
         exit(EXIT_FAILURE);
     }
 
     int user_argument;
+    int shard_count = 1;
     char *input_file = malloc(PATH_MAX);
 
     // Terminates the program early if we can't allocate memory to `input_file`.
@@ -657,8 +2603,13 @@ int main(int argc, char *argv[])
         perror("Failed to allocate memory. Terminating...\n");
         exit(EXIT_FAILURE);
     }
+    input_file[0] = '\0';
+
+    struct option long_options[] = {
+        {"shards", required_argument, NULL, 's'},
+        {NULL, 0, NULL, 0}};
 
-    while ((user_argument = getopt(argc, argv, "i:")) != -1)
+    while ((user_argument = getopt_long(argc, argv, "i:s:", long_options, NULL)) != -1)
     {
         switch (user_argument)
         {
@@ -674,12 +2625,33 @@ int main(int argc, char *argv[])
             strncpy(input_file, optarg, PATH_MAX - 1);
             input_file[PATH_MAX - 1] = '\0';
             break;
+        case 's':
+        {
+            char *endptr;
+            long parsed_shards = strtol(optarg, &endptr, 10);
+            if (*endptr != '\0' || parsed_shards <= 0 || parsed_shards > sysconf(_SC_NPROCESSORS_ONLN) * 4)
+            {
+                fprintf(stderr, "./macD: Invalid shard count '%s'. Terminating...\n", optarg);
+                free(input_file);
+                exit(EXIT_FAILURE);
+            }
+            shard_count = (int)parsed_shards;
+            break;
+        }
         default:
             free(input_file);
             exit(EXIT_FAILURE);
         }
     }
 
+    // `-i` is mandatory
+    if (input_file[0] == '\0')
+    {
+        print_usage_message();
+        free(input_file);
+        exit(EXIT_FAILURE);
+    }
+
     // If the input file doesn't exist, terminate the program early.
     if (file_exists(input_file) != 0)
     {
@@ -703,14 +2675,31 @@ int main(int argc, char *argv[])
 
     print_timestamp("Starting report");
 
-    for (int i = 0; i < program_count; i++)
+    // Lets the signal handlers flag SIGINT/SIGABRT while processes are still being launched
+    global_processes = processes;
+
+    // There's no point in a shard that owns nothing
+    if (shard_count > program_count)
+    {
+        shard_count = program_count > 0 ? program_count : 1;
+    }
+
+    if (shard_count > 1)
     {
-        launch_process(&processes[i], i);
+        run_shards(processes, &program_count, &timelimit, shard_count);
     }
+    else
+    {
+        // Processes still run (in their own process groups) if macD can't create cgroups
+        setup_cgroup_root();
 
-    monitor_processes(processes, &program_count, &timelimit);
+        build_owned_indices(processes, &program_count);
+        launch_processes(processes, &program_count);
+        monitor_processes(processes, &program_count, &timelimit);
+    }
 
     cleanup_processes(processes, &program_count);
+    teardown_cgroup_root();
 
     free(input_file);
     return 0;